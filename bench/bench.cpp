@@ -0,0 +1,109 @@
+/** Microbenchmarks of the firmware hot paths.
+
+    Built for the ATtiny1604 on the bare-metal platform (include/platform/baremetal.h), which needs neither the timers nor the interrupts the simulator does not have, and run in bin/avrsim.py by bin/bench.py, which reports the cycles and stack use of every benchmark and compares them against bench/baseline.json.
+
+    The firmware itself is included so that the benchmarks measure the very code the light runs. Each benchmark marks its start and end by writing its id to GPIOR0 and GPIOR1, the ids and names are the Bench enum below, which bin/bench.py parses. A benchmark may run several times (e.g. for different inputs), the worst case is reported.
+
+    Benchmarks of code with a cycle budget in the firmware (e.g. the effects' BUDGET) store the budget in the budget variable before they start, and bin/bench.py fails if they take more cycles than that.
+ */
+// the firmware without its main, the benchmarks have their own
+#define BENCH
+#include "../src/main.cpp"
+
+enum class Bench : uint8_t {
+    Overhead = 1,
+    HSV = 2,
+    WithBrightness = 3,
+    CheckButtonIdle = 4,
+    CheckButtonPress = 5,
+    NeopixelUpdate = 6,
+    NeopixelUpdateDimmed = 7,
+    TickRGB = 8,
+    TickWhite = 9,
+    HSVExact = 11,
+    EffectRGB = 12,
+};
+
+// inputs and results go through volatiles so that the compiler can neither precompute nor drop the benchmarked code
+volatile uint8_t input = 0;
+volatile uint8_t output;
+
+// cycle budget of the benchmark that starts next, 0 for none, read by bin/bench.py
+volatile uint16_t budget;
+
+/** Runs the function between the start and end markers of the benchmark, which must fit in the given cycle budget, if any.
+ */
+template<typename F>
+__attribute__((noinline)) void bench(Bench id, F f, uint16_t cycles = 0) {
+    budget = cycles;
+    GPIOR0 = static_cast<uint8_t>(id);
+    asm volatile("" ::: "memory");
+    f();
+    asm volatile("" ::: "memory");
+    GPIOR1 = static_cast<uint8_t>(id);
+}
+
+NeopixelStrip<8> strip8(RGB_CONTROL_PIN);
+
+int main() {
+    cpu::initialize();
+    setup();
+
+    bench(Bench::Overhead, [](){});
+
+    // the exact conversion has six branches, so measure each of them, and the wheel at the same hues
+    for (uint8_t i = 0; i < 6; ++i) {
+        uint8_t hue = i * 43;
+        bench(Bench::HSV, [hue](){
+            Color c = Color::HSV(static_cast<uint8_t>(hue + input), 255, 128);
+            output = c.r ^ c.g ^ c.b;
+        });
+        bench(Bench::HSVExact, [hue](){
+            Color c = Color::HSVExact(static_cast<uint8_t>(hue + input), 255, 128);
+            output = c.r ^ c.g ^ c.b;
+        });
+    }
+
+    strip8.fill(Color::HSV(input, 255, 255));
+    bench(Bench::WithBrightness, [](){
+        strip8.withBrightness(128 + input);
+    });
+
+    // the pin reads high (released) and so did the last check
+    buttons[0].state = true;
+    buttons[0].debounce = 0;
+    bench(Bench::CheckButtonIdle, [](){
+        output = checkButton(0, BTN_WHITE_MODE_PIN);
+    });
+    // drive the button pin low so that it reads as pressed
+    pinMode(BTN_WHITE_MODE_PIN, OUTPUT);
+    digitalWrite(BTN_WHITE_MODE_PIN, LOW);
+    bench(Bench::CheckButtonPress, [](){
+        output = checkButton(0, BTN_WHITE_MODE_PIN);
+    });
+
+    bench(Bench::NeopixelUpdate, [](){
+        strip8.markAsChanged();
+        strip8.update();
+    });
+    strip8.setBrightness(128);
+    bench(Bench::NeopixelUpdateDimmed, [](){
+        strip8.markAsChanged();
+        strip8.update();
+    });
+
+    // the RGB effect blends every tick while its transition runs, and the rainbow moves on every RAINBOW_TICKS
+    enterRGBMode();
+    for (uint8_t i = 0; i < 10; ++i)
+        bench(Bench::TickRGB, [](){ tick(); }, RGBEffect::BUDGET + CROSSFADE_BUDGET + NEOPIXEL_BUDGET);
+    enterRGBMode();
+    for (uint16_t i = 0; i < 2 * RAINBOW_TICKS; ++i)
+        bench(Bench::EffectRGB, [](){ effects.tick(); }, RGBEffect::BUDGET);
+    enterWhiteMode();
+    for (uint8_t i = 0; i < 10; ++i)
+        bench(Bench::TickWhite, [](){ tick(); }, WhiteEffect::BUDGET + CROSSFADE_BUDGET + NEOPIXEL_BUDGET);
+
+    // exit
+    GPIOR2 = 0;
+    while (true) {}
+}
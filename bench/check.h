@@ -0,0 +1,23 @@
+#pragma once
+
+/** Reporting of the host checks run by bin/hostcheck.py.
+
+    CHECK prints the condition of every failed check together with what was checked, report() prints the number of failed checks and returns the exit status of the check program.
+ */
+#include <stdio.h>
+#include <stdlib.h>
+
+inline unsigned failures = 0;
+
+#define CHECK(what, condition) \
+    do { \
+        if (! (condition)) { \
+            printf("FAILED %s: %s\n", what, # condition); \
+            ++failures; \
+        } \
+    } while (false)
+
+inline int report() {
+    printf("%u checks failed\n", failures);
+    return failures == 0 ? EXIT_SUCCESS : EXIT_FAILURE;
+}
@@ -0,0 +1,158 @@
+/** Battery life estimate of the light for a usage script.
+
+    Built for the host with the mock platform (include/platform/mock.h) and run by bin/energy.py. The firmware runs in simulated time while the script presses its buttons, and the energy model of the mock integrates the current drawn. The charge consumed is reported per mode and per load, together with the runtime a battery of given capacity gives when the script is repeated, and when the light stays in each of the modes.
+
+    The script has one command per line, # starts a comment:
+
+        press BUTTON        presses the button for 100ms, then waits 100ms
+        hold BUTTON TIME    holds the button for the given time
+        wait TIME           lets the light run
+
+    BUTTON is one of white, rgb, left, right, up and down, TIME is a number followed by ms, s, m or h. The light starts as after it is powered up, i.e. on in the remembered mode, which is RGB for the empty EEPROM.
+
+    Usage: energy SCRIPT CAPACITY_MAH
+ */
+#include "../src/main.cpp"
+
+#include <stdio.h>
+
+// 6 white LEDs, 6x15R for 3R parallel, for 200mA at 4.2V
+#define WHITE_CURRENT 200
+#define NEOPIXELS 1
+
+#define PRESS_US 100000
+
+// runtimes longer than the battery keeps its charge on the shelf are bound by its self-discharge, not by the light
+#define SHELF_LIFE_HOURS 8760
+
+struct ModeStats {
+    uint64_t time;
+    double charge;
+};
+
+// the modes, and the time the CPU is asleep
+ModeStats stats[static_cast<uint8_t>(Mode::Cue) + 2];
+char const * const modeNames[] = { "off", "white", "candle", "strobe", "rgb", "charge", "cue", "sleep" };
+uint8_t const SLEEP = static_cast<uint8_t>(Mode::Cue) + 1;
+
+int buttonPin(char const * name) {
+    static char const * const names[] = { "white", "rgb", "left", "right", "up", "down" };
+    static int const pins[] = { BTN_WHITE_MODE_PIN, BTN_RGB_MODE_PIN, BTN_EFFECT_L_PIN, BTN_EFFECT_R_PIN, BTN_BRIGHTNESS_UP_PIN, BTN_BRIGHTNESS_DOWN_PIN };
+    for (uint8_t i = 0; i < 6; ++i)
+        if (strcmp(name, names[i]) == 0)
+            return pins[i];
+    return -1;
+}
+
+/** Parses the time in microseconds, returns 0 if invalid.
+ */
+uint64_t parseTime(char const * str) {
+    char * unit;
+    double value = strtod(str, & unit);
+    if (strcmp(unit, "ms") == 0)
+        return static_cast<uint64_t>(value * 1e3);
+    if (strcmp(unit, "s") == 0)
+        return static_cast<uint64_t>(value * 1e6);
+    if (strcmp(unit, "m") == 0)
+        return static_cast<uint64_t>(value * 60e6);
+    if (strcmp(unit, "h") == 0)
+        return static_cast<uint64_t>(value * 3600e6);
+    return 0;
+}
+
+/** Schedules the button presses of the script on the board's timeline and sets the end of the simulation. Returns false on errors.
+ */
+bool loadScript(char const * filename) {
+    FILE * f = fopen(filename, "r");
+    if (f == nullptr) {
+        fprintf(stderr, "cannot open %s\n", filename);
+        return false;
+    }
+    uint64_t t = 0;
+    char line[128];
+    unsigned lineNumber = 0;
+    bool ok = true;
+    while (fgets(line, sizeof(line), f) != nullptr) {
+        ++lineNumber;
+        char * comment = strchr(line, '#');
+        if (comment != nullptr)
+            *comment = 0;
+        char cmd[16], arg1[16], arg2[16];
+        int n = sscanf(line, "%15s %15s %15s", cmd, arg1, arg2);
+        if (n <= 0)
+            continue;
+        if (strcmp(cmd, "press") == 0 && n == 2 && buttonPin(arg1) >= 0) {
+            board::schedule(t, buttonPin(arg1), LOW);
+            board::schedule(t + PRESS_US, buttonPin(arg1), HIGH);
+            t += 2 * PRESS_US;
+        } else if (strcmp(cmd, "hold") == 0 && n == 3 && buttonPin(arg1) >= 0 && parseTime(arg2) > 0) {
+            board::schedule(t, buttonPin(arg1), LOW);
+            t += parseTime(arg2);
+            board::schedule(t, buttonPin(arg1), HIGH);
+        } else if (strcmp(cmd, "wait") == 0 && n == 2 && parseTime(arg1) > 0) {
+            t += parseTime(arg1);
+        } else {
+            fprintf(stderr, "%s:%u: invalid command\n", filename, lineNumber);
+            ok = false;
+        }
+    }
+    fclose(f);
+    board::setEnd(t);
+    return ok;
+}
+
+void printRow(char const * name, uint64_t time, double charge, double capacity) {
+    double hours = time / 3600e6;
+    double current = hours > 0 ? charge / hours : 0;
+    printf("%-10s %10.2f %10.3f %10.2f", name, hours, charge, current);
+    if (current <= 0)
+        printf(" %10s\n", "-");
+    else if (capacity / current > SHELF_LIFE_HOURS)
+        printf(" %10s\n", "unbounded");
+    else
+        printf(" %10.1f\n", capacity / current);
+}
+
+int main(int argc, char * argv[]) {
+    if (argc != 3) {
+        fprintf(stderr, "usage: %s SCRIPT CAPACITY_MAH\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    double capacity = atof(argv[2]);
+    if (! loadScript(argv[1]) || capacity <= 0)
+        return EXIT_FAILURE;
+    energy::attachWhite(WHITE_PWM_PIN, WHITE_CURRENT);
+    energy::attachNeopixels(RGB_PWR_PIN, NEOPIXELS);
+    setup();
+    // charge and time of every loop go to the mode the loop started in, except the sleep
+    bool finished = false;
+    while (! finished && board::now() < board::end()) {
+        uint8_t m = static_cast<uint8_t>(mode());
+        uint64_t time = board::now();
+        double charge = energy::charge();
+        uint64_t sleepTime = energy::sleepTime();
+        double sleepCharge = energy::sleepCharge();
+        try {
+            loop();
+        } catch (board::Finished const &) {
+            finished = true;
+        }
+        uint64_t slept = energy::sleepTime() - sleepTime;
+        double sleptCharge = energy::sleepCharge() - sleepCharge;
+        stats[m].time += board::now() - time - slept;
+        stats[m].charge += energy::charge() - charge - sleptCharge;
+        stats[SLEEP].time += slept;
+        stats[SLEEP].charge += sleptCharge;
+    }
+    printf("%s, %.2fh simulated, %.0fmAh battery, %u EEPROM writes\n\n", argv[1], board::now() / 3600e6, capacity, eeprom::writes());
+    printf("%-10s %10s %10s %10s %10s\n", "mode", "hours", "mAh", "avg mA", "runtime h");
+    for (uint8_t i = 0; i <= SLEEP; ++i)
+        if (stats[i].time > 0)
+            printRow(modeNames[i], stats[i].time, stats[i].charge, capacity);
+    printRow("total", board::now(), energy::charge(), capacity);
+    printf("\n%-10s %10s\n", "load", "mAh");
+    printf("%-10s %10.3f\n", "cpu", energy::charge(energy::Load::Cpu));
+    printf("%-10s %10.3f\n", "white", energy::charge(energy::Load::White));
+    printf("%-10s %10.3f\n", "neopixels", energy::charge(energy::Load::Neopixels));
+    return EXIT_SUCCESS;
+}
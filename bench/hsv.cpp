@@ -0,0 +1,33 @@
+/** Exhaustive check of the HSV conversions.
+
+    Built for the host with the mock platform (include/platform/mock.h) and run by bin/hostcheck.py. Converts every hue, saturation and value with both Color::HSVWheel and Color::HSVExact and reports the largest difference of each channel, the number of colors that differ and the first of them. Fails if any channel differs by more than TOLERANCE.
+
+    Usage: hsv [TOLERANCE]
+ */
+#include "platform/platform.h"
+#include "utils/color.h"
+#include "check.h"
+
+int main(int argc, char * argv[]) {
+    int tolerance = argc > 1 ? atoi(argv[1]) : 0;
+    int maxError[3] = { 0, 0, 0 };
+    unsigned long differ = 0;
+    for (unsigned h = 0; h < 256; ++h) {
+        for (unsigned s = 0; s < 256; ++s) {
+            for (unsigned v = 0; v < 256; ++v) {
+                Color wheel = Color::HSVWheel(h, s, v);
+                Color exact = Color::HSVExact(h, s, v);
+                if (wheel == exact)
+                    continue;
+                if (differ++ == 0)
+                    printf("first difference: h %u s %u v %u, wheel %u %u %u, exact %u %u %u\n", h, s, v, wheel.r, wheel.g, wheel.b, exact.r, exact.g, exact.b);
+                maxError[0] = std::max(maxError[0], abs(wheel.r - exact.r));
+                maxError[1] = std::max(maxError[1], abs(wheel.g - exact.g));
+                maxError[2] = std::max(maxError[2], abs(wheel.b - exact.b));
+            }
+        }
+    }
+    printf("%u colors, %lu differ, max error r %d g %d b %d\n", 256 * 256 * 256, differ, maxError[0], maxError[1], maxError[2]);
+    CHECK("channels within the tolerance", std::max(maxError[0], std::max(maxError[1], maxError[2])) <= tolerance);
+    return report();
+}
@@ -0,0 +1,138 @@
+/** Checks of the neopixel current limit.
+
+    Built for the host with the mock platform (include/platform/mock.h) and run by bin/hostcheck.py. Checks that the channel sum ColorStrip keeps up to date while drawing always equals a recount of the pixels, and that NeopixelStrip sends a frame over its current limit at the highest brightness that fits, with the current taken from the energy model of the mock. Prints every failed check and fails if there are any.
+
+    Usage: limit
+ */
+#include "platform/platform.h"
+#include "peripherals/neopixel.h"
+#include "utils/palettes.h"
+#include "check.h"
+
+#define PIXELS 30
+#define DATA_PIN 7
+// the rail of the energy model, kept on
+#define RAIL_PIN 6
+
+/** Channel sum of the strip counted from its pixels.
+ */
+template<uint16_t SIZE>
+uint32_t recount(ColorStrip<SIZE> const & strip) {
+    uint32_t sum = 0;
+    for (uint16_t i = 0; i < SIZE; ++i)
+        sum += static_cast<uint16_t>(strip[i].r) + strip[i].g + strip[i].b;
+    return sum;
+}
+
+/** Checks that the kept channel sum matches the pixels after the drawing.
+ */
+template<uint16_t SIZE>
+void checkSum(char const * what, ColorStrip<SIZE> & strip) {
+    uint32_t kept = strip.channelSum();
+    uint32_t counted = recount(strip);
+    if (kept != counted) {
+        printf("FAILED channel sum after %s: kept %u, counted %u\n", what, static_cast<unsigned>(kept), static_cast<unsigned>(counted));
+        ++failures;
+    }
+}
+
+/** Sends the strip and returns the current the neopixels then draw in mA, per the energy model.
+ */
+template<typename STRIP>
+double current(STRIP & strip) {
+    strip.markAsChanged();
+    strip.update();
+    double before = energy::charge(energy::Load::Neopixels);
+    // an hour, so that mAh are mA
+    board::advance(3600000000ull, board::CpuState::Idle);
+    return energy::charge(energy::Load::Neopixels) - before;
+}
+
+// static like the strips of the firmware, so that they start black
+ColorStrip<PIXELS> drawn;
+ColorStrip<PIXELS> other;
+NeopixelStrip<PIXELS> strip(DATA_PIN);
+
+void checkChannelSum() {
+    checkSum("start", drawn);
+    drawn.fill(Color::White());
+    checkSum("fill", drawn);
+    CHECK("full white", drawn.channelSum() == PIXELS * 765);
+    drawn.fill(Color::Red(), 16);
+    checkSum("fill by steps", drawn);
+    drawn.set(3, Color::Black());
+    drawn.set(4, Color::RGB(1, 2, 3));
+    checkSum("set", drawn);
+    drawn.withBrightness(100);
+    checkSum("withBrightness", drawn);
+    other.fillPalette(DUSK_PALETTE, 10);
+    checkSum("fillPalette", other);
+    other.mapPalette(FIRE_PALETTE, [](uint16_t i) { return static_cast<uint8_t>(i * 7); }, 32);
+    checkSum("mapPalette", other);
+    drawn.blend(drawn, other, 100);
+    checkSum("blend", drawn);
+    for (uint8_t i = 0; i < 10; ++i) {
+        drawn.moveTowards(other, 9);
+        checkSum("moveTowards", drawn);
+        drawn.moveTowardsReversed(other, 5);
+        checkSum("moveTowardsReversed", drawn);
+    }
+    drawn.showPoint(500, 1000, Color::Cyan());
+    checkSum("showPoint", drawn);
+    drawn.showBar(333, 1000, Color::Purple(), 64);
+    checkSum("showBar", drawn);
+    drawn.showBarCentered(800, 1000, Color::Yellow());
+    checkSum("showBarCentered", drawn);
+}
+
+void checkLimit() {
+    energy::attachNeopixels(RAIL_PIN, PIXELS);
+    strip.fill(Color::White());
+    double full = current(strip);
+    CHECK("no limit sends at full brightness", strip.appliedBrightness() == 255);
+    CHECK("30 white pixels draw ~1.8A", full > 1800 && full < 1900);
+
+    strip.setCurrentLimit(500);
+    double limited = current(strip);
+    uint8_t applied = strip.appliedBrightness();
+    printf("%u white pixels limited to 500mA: brightness %u, %.0fmA\n", PIXELS, applied, limited);
+    CHECK("limited frame fits the limit", limited <= 500);
+    // the limit takes the exact scaled channels, the neopixels get them rounded down, so one step brighter may still just fit
+    strip.setCurrentLimit(0);
+    strip.setBrightness(applied + 2);
+    CHECK("two steps brighter would not fit", current(strip) > 500);
+    strip.setBrightness(255);
+
+    // a frame that fits is sent at the brightness it is given
+    strip.setCurrentLimit(500);
+    strip.fill(Color::Black());
+    strip.set(0, Color::White());
+    current(strip);
+    CHECK("frame within the limit is not dimmed", strip.appliedBrightness() == 255);
+    strip.setBrightness(40);
+    current(strip);
+    CHECK("brightness below the limit is kept", strip.appliedBrightness() == 40);
+    strip.setBrightness(255);
+
+    // the limit follows the pixels drawn, without a recount
+    strip.fill(Color::White());
+    current(strip);
+    uint8_t white = strip.appliedBrightness();
+    for (uint8_t i = 0; i < PIXELS / 2; ++i)
+        strip.set(i, Color::Black());
+    current(strip);
+    CHECK("half the pixels are brighter", strip.appliedBrightness() > white);
+
+    // a limit below the idle current of the neopixels leaves them black
+    strip.setCurrentLimit(20);
+    current(strip);
+    CHECK("limit below the quiescent current", strip.appliedBrightness() == 0);
+}
+
+int main() {
+    board::pinMode(RAIL_PIN, OUTPUT);
+    board::write(RAIL_PIN, LOW);
+    checkChannelSum();
+    checkLimit();
+    return report();
+}
@@ -0,0 +1,167 @@
+/** Checks of the I2C slave and serial register files.
+
+    Built for the host with the mock platform (include/platform/mock.h) and run by bin/hostcheck.py. Plays the I2C master by calling the bus event handlers of I2CRegisters (onAddress, onWrite, onRead and onStop) directly, as the TWI slave interrupt does on the chip, and the serial host by feeding frames to onReceive() of SerialRegisters, and checks what the master and the firmware see. Prints every failed check and fails if there are any.
+
+    Usage: registers
+ */
+#include "platform/platform.h"
+#include "utils/i2c_registers.h"
+#include "utils/serial_registers.h"
+#include "check.h"
+
+/** The register file of the checks, the first four bytes are writable and a 16bit value straddles the boundary of the writable part.
+ */
+struct Registers {
+    uint8_t mode;
+    uint8_t brightness;
+    uint16_t level;
+    uint16_t telemetry;
+    uint8_t status;
+} __attribute__((packed));
+
+using Slave = I2CRegisters<Registers, 4>;
+using Serial = SerialRegisters<Registers, 4>;
+
+/** Master writes the bytes to consecutive registers from index, returns the number of bytes acknowledged. The transaction ends with a stop unless told otherwise.
+ */
+uint8_t write(uint8_t index, uint8_t const * data, uint8_t size, bool stop = true) {
+    Slave::onAddress(false);
+    uint8_t acked = 0;
+    if (Slave::onWrite(index))
+        for (uint8_t i = 0; i < size && Slave::onWrite(data[i]); ++i)
+            ++acked;
+    if (stop)
+        Slave::onStop();
+    return acked;
+}
+
+/** Master sets the index and reads size bytes after a repeated start.
+ */
+void read(uint8_t index, uint8_t * data, uint8_t size) {
+    Slave::onAddress(false);
+    Slave::onWrite(index);
+    Slave::onAddress(true);
+    for (uint8_t i = 0; i < size; ++i)
+        data[i] = Slave::onRead();
+    Slave::onStop();
+}
+
+/** Host sends a serial WRITE frame of the bytes to consecutive registers from index.
+ */
+void serialWrite(uint8_t index, uint8_t const * data, uint8_t size) {
+    uint8_t frame[2 + 1 + Serial::MAX_PAYLOAD] = { Serial::WRITE, static_cast<uint8_t>(size + 1), index };
+    memcpy(frame + 3, data, size);
+    Serial::onReceive(Serial::SYNC);
+    for (uint8_t i = 0; i < size + 3; ++i)
+        Serial::onReceive(frame[i]);
+    Serial::onReceive(CRC8(frame, size + 3));
+}
+
+Registers state() {
+    Registers r;
+    r.mode = 1;
+    r.brightness = 100;
+    r.level = 0x1234;
+    r.telemetry = 0xbeef;
+    r.status = 7;
+    return r;
+}
+
+int main() {
+    Slave::initialize(0x50);
+    Registers firmware = state();
+    Registers fetched;
+    Slave::publish(firmware);
+    CHECK("nothing written after the start", ! Slave::pending() && ! Slave::fetch(fetched));
+
+    // the master reads the whole file, and past its end
+    uint8_t bytes[sizeof(Registers) + 2];
+    read(0, bytes, sizeof(bytes));
+    CHECK("read the published state", memcmp(bytes, & firmware, sizeof(Registers)) == 0);
+    CHECK("registers past the end read 0xff", bytes[sizeof(Registers)] == 0xff && bytes[sizeof(Registers) + 1] == 0xff);
+
+    // a write is staged until the stop, so the firmware never sees half of it
+    uint8_t level[] = { 0x78, 0x56 };
+    CHECK("write within the writable part is acknowledged", write(2, level, 2, false) == 2);
+    CHECK("staged write is not pending before the stop", ! Slave::pending());
+    Slave::onStop();
+    CHECK("write is pending after the stop", Slave::pending());
+    CHECK("write is fetched with its registers", Slave::fetch(fetched) == Slave::mask(2, 2) && fetched.level == 0x5678 && fetched.mode == 1 && fetched.telemetry == 0xbeef);
+    CHECK("write is fetched only once", ! Slave::pending() && ! Slave::fetch(fetched));
+
+    // bytes past the writable part are not acknowledged and not written
+    firmware.level = 0x5678;
+    Slave::publish(firmware);
+    uint8_t across[] = { 0x11, 0x22, 0x33, 0x44 };
+    CHECK("write across the writable boundary stops at it", write(3, across, 4) == 1);
+    CHECK("only the writable byte is written", Slave::fetch(fetched) == Slave::mask(3) && fetched.level == 0x1178 && fetched.telemetry == 0xbeef && fetched.status == 7);
+    uint8_t readOnly[] = { 0x99 };
+    CHECK("write to a read only register is not acknowledged", write(4, readOnly, 1) == 0);
+    CHECK("write to a read only register is not pending", ! Slave::pending());
+    read(4, bytes, 3);
+    CHECK("read only registers keep their value", bytes[0] == 0xef && bytes[1] == 0xbe && bytes[2] == 7);
+
+    // the firmware publishing before it fetched the write must not lose it, but updates the read only part
+    uint8_t mode[] = { 3, 200 };
+    write(0, mode, 2);
+    firmware.telemetry = 0xcafe;
+    Slave::publish(firmware);
+    CHECK("publish keeps the unfetched write", Slave::fetch(fetched) && fetched.mode == 3 && fetched.brightness == 200);
+    CHECK("publish updates the read only part", fetched.telemetry == 0xcafe);
+    Slave::publish(firmware);
+    read(0, bytes, 2);
+    CHECK("publish after the fetch overwrites the write", bytes[0] == 1 && bytes[1] == 100);
+
+    // a write of one register leaves the others to the firmware, and marks only itself as written
+    uint8_t single[] = { 150 };
+    write(1, single, 1);
+    firmware.mode = 2;
+    Slave::publish(firmware);
+    CHECK("single register write is marked alone", Slave::fetch(fetched) == Slave::mask(1) && fetched.brightness == 150);
+    CHECK("publish updates the registers not written", fetched.mode == 2);
+    write(0, single, 1);
+    write(2, level, 1);
+    CHECK("writes before the fetch add up", Slave::fetch(fetched) == (Slave::mask(0) | Slave::mask(2)));
+    firmware.mode = 1;
+    Slave::publish(firmware);
+
+    // a repeated start commits the write like the stop does
+    uint8_t brightness[] = { 42 };
+    write(1, brightness, 1, false);
+    Slave::onAddress(true);
+    CHECK("repeated start commits the write", Slave::pending());
+    Slave::onStop();
+    CHECK("write committed by the repeated start is fetched", Slave::fetch(fetched) == Slave::mask(1) && fetched.brightness == 42);
+
+    // reads are served from the snapshot taken when the master addressed the slave
+    Slave::publish(firmware);
+    Slave::onAddress(false);
+    Slave::onWrite(4);
+    Slave::onAddress(true);
+    bytes[0] = Slave::onRead();
+    firmware.telemetry = 0x0102;
+    Slave::publish(firmware);
+    bytes[1] = Slave::onRead();
+    Slave::onStop();
+    CHECK("publish does not tear a read", bytes[0] == 0xfe && bytes[1] == 0xca);
+
+    // the serial register file marks the written registers the same way
+    Serial::initialize(115200);
+    firmware = state();
+    Serial::publish(firmware);
+    CHECK("nothing written over serial after the start", ! Serial::pending() && Serial::fetch(fetched) == 0);
+    uint8_t serialBrightness[] = { 150 };
+    serialWrite(1, serialBrightness, 1);
+    firmware.mode = 2;
+    Serial::publish(firmware);
+    CHECK("single serial register write is marked alone", Serial::fetch(fetched) == Serial::mask(1) && fetched.brightness == 150);
+    CHECK("serial publish updates the registers not written", fetched.mode == 2);
+    serialWrite(2, level, 2);
+    serialWrite(0, serialBrightness, 1);
+    CHECK("serial writes before the fetch add up", Serial::fetch(fetched) == (Serial::mask(0) | Serial::mask(2, 2)) && fetched.level == 0x5678);
+    uint8_t tooLong[] = { 1, 2, 3 };
+    serialWrite(2, tooLong, 3);
+    CHECK("serial write past the writable registers is ignored", Serial::fetch(fetched) == 0);
+
+    return report();
+}
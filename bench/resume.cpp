@@ -0,0 +1,91 @@
+/** Wakeup latency of the light.
+
+    Built for the host with the mock platform (include/platform/mock.h) and the I2C_CONTROL build flag, and run by bin/hostcheck.py. The light is powered off by the stage controller and, once asleep, woken up again by each of:
+
+        white   the white mode button, till the white LED lights
+        rgb     the RGB mode button, till the neopixel lights
+        i2c     the stage controller writing the white mode, till the white LED lights
+
+    Prints the latency of each, from the press or the end of the I2C write to the light, and fails if any is above MAX_LATENCY_US or the light does not come on at all.
+
+    The mock runs the code in no time, so the latency is made of the ticks the light takes to show something, which is what the warm resume path keeps short.
+
+    Usage: resume [MAX_LATENCY_US]
+ */
+#include "../src/main.cpp"
+#include "check.h"
+
+#if (! defined I2C_CONTROL)
+    #error "Must be built with I2C_CONTROL"
+#endif
+
+#define PRESS_US 100000
+// the light fades out and goes to sleep well within this
+#define ASLEEP_US 2000000
+// the light must come on well within this, or it is considered dark
+#define TIMEOUT_US 1000000
+
+enum class Wakeup : uint8_t {
+    White,
+    RGB,
+    I2C,
+};
+
+char const * const wakeupNames[] = { "white", "rgb", "i2c" };
+
+void writeMode(uint64_t time, Mode m) {
+    board::scheduleI2CWrite(time, { 0, static_cast<uint8_t>(m), 128 });
+}
+
+bool whiteLit() {
+    return board::duty(WHITE_PWM_PIN) > 0;
+}
+
+/** Powers the light off, wakes it up in the given way once asleep and returns the time from the wakeup to the light, UINT64_MAX if it stayed dark.
+ */
+uint64_t wakeup(Wakeup how) {
+    writeMode(board::now(), Mode::Off);
+    uint64_t start = board::now() + ASLEEP_US;
+    switch (how) {
+        case Wakeup::White:
+            board::schedule(start, BTN_WHITE_MODE_PIN, LOW);
+            board::schedule(start + PRESS_US, BTN_WHITE_MODE_PIN, HIGH);
+            break;
+        case Wakeup::RGB:
+            board::schedule(start, BTN_RGB_MODE_PIN, LOW);
+            board::schedule(start + PRESS_US, BTN_RGB_MODE_PIN, HIGH);
+            break;
+        case Wakeup::I2C:
+            writeMode(start, Mode::White);
+            break;
+    }
+    while (board::now() < start + TIMEOUT_US) {
+        loop();
+        if (board::now() < start)
+            continue;
+        if (how == Wakeup::RGB) {
+            if (energy::neopixelsLit())
+                return energy::neopixelsSent() - start;
+        } else if (whiteLit()) {
+            return board::changed(WHITE_PWM_PIN) - start;
+        }
+    }
+    return UINT64_MAX;
+}
+
+int main(int argc, char * argv[]) {
+    uint64_t maxLatency = argc > 1 ? strtoull(argv[1], nullptr, 10) : 10000;
+    energy::attachNeopixels(RGB_PWR_PIN, 1);
+    board::attachI2CSlave(Control::onAddress, Control::onWrite, Control::onStop);
+    board::setEnd(UINT64_MAX);
+    setup();
+    for (uint8_t i = 0; i < 3; ++i) {
+        uint64_t latency = wakeup(static_cast<Wakeup>(i));
+        if (latency == UINT64_MAX)
+            printf("%-6s dark\n", wakeupNames[i]);
+        else
+            printf("%-6s %6.1f ms\n", wakeupNames[i], latency / 1000.0);
+        CHECK(wakeupNames[i], latency <= maxLatency);
+    }
+    return report();
+}
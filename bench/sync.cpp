@@ -0,0 +1,92 @@
+/** A light on the sync wire, for checking that synchronized lights stay in step.
+
+    Built for the host with the mock platform (include/platform/mock.h) as either the SYNC_LEADER or a SYNC_FOLLOWER and run by bin/sync.py, once for the leader and once for every follower. The leader runs first and writes the bytes it sends to the wire into the BEACONS file, every follower then receives them as it runs. As the leader does not listen to the followers, running the lights one after another is the same as running them together.
+
+    A follower is powered up START after the leader and its clock is off by the given parts per million, so that the lights drift apart when not synchronized. Every light prints a line for every tick, with the time the tick started on the leader's timeline in microseconds, the timebase, the hue, the white level and the RGB color shown:
+
+        TIME TICKS HUE WHITE R G B
+
+    The EFFECT is either rainbow, the light being on in the RGB mode with the rainbow as for the empty EEPROM, or candle, selected by the buttons 100ms and 400ms after the light is powered up.
+
+    Usage: sync DURATION_US BEACONS EFFECT [START_US CLOCK_PPM]
+ */
+#include "../src/main.cpp"
+
+#include <stdio.h>
+
+#if (! defined SYNC)
+    #error "Must be built as the SYNC_LEADER or a SYNC_FOLLOWER"
+#endif
+
+#define PRESS_US 100000
+
+void press(uint64_t time, uint8_t pin) {
+    board::schedule(time, pin, LOW);
+    board::schedule(time + PRESS_US, pin, HIGH);
+}
+
+/** Schedules the beacons of the leader sent after the follower was powered up.
+ */
+bool loadBeacons(char const * filename, uint64_t start) {
+    FILE * f = fopen(filename, "r");
+    if (f == nullptr) {
+        fprintf(stderr, "cannot open %s\n", filename);
+        return false;
+    }
+    unsigned long long time;
+    unsigned value;
+    while (fscanf(f, "%llu %u", & time, & value) == 2)
+        if (time >= start)
+            board::scheduleReceive(time - start, static_cast<uint8_t>(value));
+    fclose(f);
+    return true;
+}
+
+bool saveBeacons(char const * filename) {
+    FILE * f = fopen(filename, "w");
+    if (f == nullptr) {
+        fprintf(stderr, "cannot write %s\n", filename);
+        return false;
+    }
+    for (size_t i = 0; i < board::transmittedCount(); ++i)
+        fprintf(f, "%llu %u\n", static_cast<unsigned long long>(board::transmittedTime(i)), board::transmittedValue(i));
+    fclose(f);
+    return true;
+}
+
+int main(int argc, char * argv[]) {
+    if (argc != 4 && argc != 6) {
+        fprintf(stderr, "usage: %s DURATION_US BEACONS EFFECT [START_US CLOCK_PPM]\n", argv[0]);
+        return EXIT_FAILURE;
+    }
+    uint64_t duration = strtoull(argv[1], nullptr, 10);
+    uint64_t start = argc == 6 ? strtoull(argv[4], nullptr, 10) : 0;
+    board::setClockError(argc == 6 ? atoi(argv[5]) : 0);
+    if (strcmp(argv[3], "candle") == 0) {
+        press(100000, BTN_WHITE_MODE_PIN);
+        press(400000, BTN_EFFECT_L_PIN);
+    } else if (strcmp(argv[3], "rainbow") != 0) {
+        fprintf(stderr, "unknown effect %s\n", argv[3]);
+        return EXIT_FAILURE;
+    }
+#if (defined SYNC_FOLLOWER)
+    if (! loadBeacons(argv[2], start))
+        return EXIT_FAILURE;
+    board::attachReceiver(Sync::onReceive);
+#endif
+    board::setEnd(duration - start);
+    setup();
+    while (board::now() < board::end()) {
+        uint64_t time = board::now() + start;
+        loop();
+        // a copy, as accessing the pixels marks the strip as changed
+        ColorStrip<1> shown = currentRgb;
+        Color c = shown[0];
+        printf("%llu %u %u %u %u %u %u\n", static_cast<unsigned long long>(time), Sync::ticks(), hue, currentBrightness, c.r, c.g, c.b);
+    }
+#if (defined SYNC_LEADER)
+    if (! saveBeacons(argv[2]))
+        return EXIT_FAILURE;
+#endif
+    return EXIT_SUCCESS;
+}
@@ -0,0 +1,43 @@
+/** Neopixel waveform firmware for bin/wavecheck.py.
+
+    Sends a known pattern to a neopixel strip on RGB_CONTROL_PIN (PB0), once at full brightness and once dimmed by the bit loop, each between the start and end markers (GPIOR0 and GPIOR1) with the Wave id. bin/wavecheck.py decodes the pin trace back to bytes, compares them with the pattern, which it reads from the simulator memory, and checks the pulse timings.
+ */
+#include "platform/platform.h"
+#include "peripherals/neopixel.h"
+
+#define RGB_CONTROL_PIN 7
+#define PIXELS 4
+
+enum class Wave : uint8_t {
+    Buffer = 1,
+    Dimmed = 2,
+};
+
+// wire order (GRB) bytes, covering all bit neighbourhoods and both ends of the byte
+uint8_t pattern[PIXELS * 3] = {
+    0x00, 0xff, 0xaa,
+    0x55, 0x81, 0x7e,
+    0x01, 0x80, 0xc3,
+    0x3c, 0x0f, 0xf0,
+};
+
+NeopixelStrip<PIXELS> strip(RGB_CONTROL_PIN);
+
+void send(Wave id) {
+    GPIOR0 = static_cast<uint8_t>(id);
+    strip.markAsChanged();
+    strip.update();
+    GPIOR1 = static_cast<uint8_t>(id);
+}
+
+int main() {
+    digitalWrite(RGB_CONTROL_PIN, LOW);
+    for (uint8_t i = 0; i < PIXELS; ++i)
+        strip.set(i, Color::RGB(pattern[i * 3 + 1], pattern[i * 3], pattern[i * 3 + 2]));
+    send(Wave::Buffer);
+    strip.setBrightness(128);
+    send(Wave::Dimmed);
+    // exit
+    GPIOR2 = 0;
+    while (true) {}
+}
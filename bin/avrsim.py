@@ -0,0 +1,661 @@
+#!/usr/bin/env python3
+"""Cycle counting simulator of the AVRxt core (tinyAVR 0/1-series, megaAVR 0-series).
+
+simavr and the other free simulators only implement the older AVRe cores whose instruction timings differ from the ATtiny1604 (a store takes 2 cycles instead of 1, a push 2 instead of 1, etc.), which is exactly what the hand timed neopixel loop depends on. This simulator implements the AVRxt instruction set with the cycle counts from the AVR instruction set manual, and the parts of the ATtiny1604 that the benchmarks need: the register file, SRAM, flash mapped into the data space, the GPIO ports and the general purpose IO registers, which the simulated firmware uses to talk to the host:
+
+    GPIOR0 (0x1c)   write: start of the section with given id
+    GPIOR1 (0x1d)   write: end of the section with given id
+    GPIOR2 (0x1e)   write: exit, the value is the exit status
+
+Other peripherals read as zero and ignore writes. There are no interrupts. Reads of data mapped flash are counted as SRAM reads.
+
+Used by bin/bench.py and bin/wavecheck.py, can also run a firmware directly:
+
+    avrsim.py firmware.elf [--max-cycles N]
+"""
+
+import argparse
+import struct
+import sys
+
+# ATtiny1604 memory map
+SRAM_START = 0x3c00
+RAMEND = 0x3fff
+FLASH_MAPPED = 0x8000
+FLASH_SIZE = 16 * 1024
+
+SPL = 0x3d
+SPH = 0x3e
+SREG = 0x3f
+
+GPIOR0 = 0x1c
+GPIOR1 = 0x1d
+GPIOR2 = 0x1e
+
+# VPORT and PORT registers of the ports, the VPORT registers are aliases of the PORT registers
+PORTS = { "A" : (0x0000, 0x0400), "B" : (0x0004, 0x0420), "C" : (0x0008, 0x0440) }
+
+FLAG_C = 0
+FLAG_Z = 1
+FLAG_N = 2
+FLAG_V = 3
+FLAG_S = 4
+FLAG_H = 5
+FLAG_T = 6
+FLAG_I = 7
+
+
+class SimError(Exception):
+    pass
+
+
+class Port:
+    """GPIO port. Pins configured as inputs read the given input levels (pulled up by default)."""
+
+    def __init__(self, name, sim):
+        self.name = name
+        self.sim = sim
+        self.dir = 0
+        self.out = 0
+        self.inputs = 0xff
+        # list of (cycle, out) for every change of the output register
+        self.trace = []
+
+    def input(self):
+        return (self.out & self.dir) | (self.inputs & ~self.dir & 0xff)
+
+    def setOut(self, value):
+        value &= 0xff
+        if value != self.out:
+            self.out = value
+            self.trace.append((self.sim.cycles, value))
+
+
+def load_elf(path):
+    """Returns the flash image of the ELF file, built from its loadable segments."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    if elf[:4] != b"\x7fELF" or elf[4] != 1 or elf[5] != 1:
+        raise SimError("{} is not a 32bit little endian ELF file".format(path))
+    phoff, = struct.unpack_from("<I", elf, 28)
+    phentsize, phnum = struct.unpack_from("<HH", elf, 42)
+    flash = bytearray(b"\xff" * FLASH_SIZE)
+    for i in range(phnum):
+        ptype, offset, vaddr, paddr, filesz, memsz = struct.unpack_from("<IIIIII", elf, phoff + i * phentsize)
+        # PT_LOAD at flash addresses, the data segment is loaded from flash by the startup code
+        if ptype != 1 or filesz == 0 or paddr >= 0x800000:
+            continue
+        if paddr + filesz > FLASH_SIZE:
+            raise SimError("segment at {:x} does not fit in the flash".format(paddr))
+        flash[paddr:paddr + filesz] = elf[offset:offset + filesz]
+    return bytes(flash)
+
+
+def load_symbols(path):
+    """Returns a dict of the symbols in the ELF file and their addresses."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    shoff, = struct.unpack_from("<I", elf, 32)
+    shentsize, shnum = struct.unpack_from("<HH", elf, 46)
+    sections = [struct.unpack_from("<IIIIIIIIII", elf, shoff + i * shentsize) for i in range(shnum)]
+    result = {}
+    for name, stype, flags, addr, offset, size, link, info, align, entsize in sections:
+        # SHT_SYMTAB
+        if stype != 2:
+            continue
+        strtab = sections[link]
+        for i in range(size // 16):
+            sname, value, ssize, sinfo, sother, shndx = struct.unpack_from("<IIIBBH", elf, offset + i * 16)
+            end = elf.index(b"\0", strtab[4] + sname)
+            result[elf[strtab[4] + sname:end].decode()] = value
+    return result
+
+
+class Sim:
+
+    def __init__(self, flash):
+        self.flash = flash
+        self.words = struct.unpack("<{}H".format(len(flash) // 2), flash)
+        self.r = bytearray(32)
+        self.data = bytearray(0x10000)
+        self.sreg = 0
+        self.sp = RAMEND
+        self.pc = 0
+        self.cycles = 0
+        self.ports = { name : Port(name, self) for name in PORTS }
+        self.portRegs = {}
+        for name, (vport, port) in PORTS.items():
+            self.portRegs[vport] = (name, "DIR")
+            self.portRegs[vport + 1] = (name, "OUT")
+            self.portRegs[vport + 2] = (name, "IN")
+            self.portRegs[port] = (name, "DIR")
+            self.portRegs[port + 1] = (name, "DIRSET")
+            self.portRegs[port + 2] = (name, "DIRCLR")
+            self.portRegs[port + 3] = (name, "DIRTGL")
+            self.portRegs[port + 4] = (name, "OUT")
+            self.portRegs[port + 5] = (name, "OUTSET")
+            self.portRegs[port + 6] = (name, "OUTCLR")
+            self.portRegs[port + 7] = (name, "OUTTGL")
+            self.portRegs[port + 8] = (name, "IN")
+        # section markers, callbacks called with the id, or exit status
+        self.onStart = None
+        self.onEnd = None
+        self.exitStatus = None
+        # lowest stack pointer seen, reset by the user
+        self.minSp = RAMEND
+
+    # memory --------------------------------------------------------------------------------------
+
+    def read(self, addr):
+        addr &= 0xffff
+        if addr == SPL:
+            return self.sp & 0xff
+        if addr == SPH:
+            return self.sp >> 8
+        if addr == SREG:
+            return self.sreg
+        if addr in self.portRegs:
+            name, reg = self.portRegs[addr]
+            port = self.ports[name]
+            if reg == "DIR":
+                return port.dir
+            if reg == "OUT":
+                return port.out
+            if reg == "IN":
+                return port.input()
+            return 0
+        if addr >= FLASH_MAPPED:
+            offset = addr - FLASH_MAPPED
+            return self.flash[offset] if offset < len(self.flash) else 0xff
+        return self.data[addr]
+
+    def write(self, addr, value):
+        addr &= 0xffff
+        value &= 0xff
+        if addr == SPL:
+            self.sp = (self.sp & 0xff00) | value
+        elif addr == SPH:
+            self.sp = (self.sp & 0xff) | (value << 8)
+        elif addr == SREG:
+            self.sreg = value
+        elif addr in self.portRegs:
+            name, reg = self.portRegs[addr]
+            port = self.ports[name]
+            if reg == "DIR":
+                port.dir = value
+            elif reg == "DIRSET":
+                port.dir |= value
+            elif reg == "DIRCLR":
+                port.dir &= ~value & 0xff
+            elif reg == "DIRTGL":
+                port.dir ^= value
+            elif reg == "OUT":
+                port.setOut(value)
+            elif reg == "OUTSET":
+                port.setOut(port.out | value)
+            elif reg == "OUTCLR":
+                port.setOut(port.out & ~value)
+            elif reg == "OUTTGL" or reg == "IN":
+                # writing ones to the input register toggles the outputs
+                port.setOut(port.out ^ value)
+        elif addr == GPIOR0:
+            self.data[addr] = value
+            if self.onStart:
+                self.onStart(value)
+        elif addr == GPIOR1:
+            self.data[addr] = value
+            if self.onEnd:
+                self.onEnd(value)
+        elif addr == GPIOR2:
+            self.exitStatus = value
+        elif addr < FLASH_MAPPED:
+            self.data[addr] = value
+
+    def push(self, value):
+        self.write(self.sp, value)
+        self.sp = (self.sp - 1) & 0xffff
+        if self.sp < self.minSp:
+            self.minSp = self.sp
+
+    def pop(self):
+        self.sp = (self.sp + 1) & 0xffff
+        return self.read(self.sp)
+
+    def pushPc(self, pc):
+        self.push(pc & 0xff)
+        self.push(pc >> 8)
+
+    def popPc(self):
+        hi = self.pop()
+        return (hi << 8) | self.pop()
+
+    # flags ---------------------------------------------------------------------------------------
+
+    def flag(self, bit):
+        return (self.sreg >> bit) & 1
+
+    def setFlags(self, **flags):
+        s = self.sreg
+        for name, value in flags.items():
+            bit = globals()["FLAG_" + name]
+            s = (s | (1 << bit)) if value else (s & ~(1 << bit))
+        # S = N ^ V
+        n = (s >> FLAG_N) & 1
+        v = (s >> FLAG_V) & 1
+        s = (s | (1 << FLAG_S)) if (n ^ v) else (s & ~(1 << FLAG_S))
+        self.sreg = s & 0xff
+
+    def add(self, d, r, carry):
+        res = (d + r + carry) & 0xff
+        self.setFlags(
+            H = (((d & 0xf) + (r & 0xf) + carry) >> 4) & 1,
+            V = ((~(d ^ r) & (d ^ res)) >> 7) & 1,
+            N = res >> 7,
+            Z = res == 0,
+            C = (d + r + carry) > 0xff)
+        return res
+
+    def sub(self, d, r, carry, keepZ = False):
+        res = (d - r - carry) & 0xff
+        z = (res == 0) and (self.flag(FLAG_Z) if keepZ else True)
+        self.setFlags(
+            H = ((d & 0xf) - (r & 0xf) - carry) < 0,
+            V = (((d ^ r) & (d ^ res)) >> 7) & 1,
+            N = res >> 7,
+            Z = z,
+            C = (d - r - carry) < 0)
+        return res
+
+    def logic(self, res):
+        self.setFlags(V = 0, N = res >> 7, Z = res == 0)
+        return res
+
+    # execution -----------------------------------------------------------------------------------
+
+    def fetch(self, pc):
+        if pc >= len(self.words):
+            raise SimError("pc {:04x} out of flash".format(pc * 2))
+        return self.words[pc]
+
+    def skipSize(self):
+        """Returns the number of words of the instruction after the current one, for skips."""
+        w = self.fetch(self.pc)
+        # LDS, STS, JMP, CALL are two words
+        if (w & 0xfc0f) == 0x9000 or (w & 0xfe0e) == 0x940c or (w & 0xfe0e) == 0x940e:
+            return 2
+        return 1
+
+    def run(self, maxCycles = 10000000):
+        while self.exitStatus is None:
+            if self.cycles > maxCycles:
+                raise SimError("did not finish in {} cycles, pc {:04x}".format(maxCycles, self.pc * 2))
+            self.step()
+        return self.exitStatus
+
+    def step(self):
+        pc = self.pc
+        w = self.fetch(pc)
+        self.pc = pc + 1
+        r = self.r
+        hi = w >> 12
+        if hi == 0x0:
+            if w == 0:
+                self.cycles += 1                                        # NOP
+                return
+            op = (w >> 8) & 0xf
+            if op == 0x1:                                               # MOVW
+                d = ((w >> 4) & 0xf) * 2
+                s = (w & 0xf) * 2
+                r[d] = r[s]
+                r[d + 1] = r[s + 1]
+                self.cycles += 1
+                return
+            if op == 0x2:                                               # MULS
+                d = 16 + ((w >> 4) & 0xf)
+                s = 16 + (w & 0xf)
+                self.mul(self.signed(r[d]) * self.signed(r[s]), False)
+                return
+            if op == 0x3:                                               # MULSU, FMUL, FMULS, FMULSU
+                d = 16 + ((w >> 4) & 0x7)
+                s = 16 + (w & 0x7)
+                kind = ((w >> 6) & 0x2) | ((w >> 3) & 0x1)
+                if kind == 0:
+                    self.mul(self.signed(r[d]) * r[s], False)
+                elif kind == 1:
+                    self.mul(r[d] * r[s], True)
+                elif kind == 2:
+                    self.mul(self.signed(r[d]) * self.signed(r[s]), True)
+                else:
+                    self.mul(self.signed(r[d]) * r[s], True)
+                return
+            d = (w >> 4) & 0x1f
+            s = (w & 0xf) | ((w >> 5) & 0x10)
+            op = (w >> 10) & 0x3
+            if op == 0x1:                                               # CPC
+                self.sub(r[d], r[s], self.flag(FLAG_C), True)
+            elif op == 0x2:                                             # SBC
+                r[d] = self.sub(r[d], r[s], self.flag(FLAG_C), True)
+            else:                                                       # ADD
+                r[d] = self.add(r[d], r[s], 0)
+            self.cycles += 1
+            return
+        if hi == 0x1:
+            d = (w >> 4) & 0x1f
+            s = (w & 0xf) | ((w >> 5) & 0x10)
+            op = (w >> 10) & 0x3
+            if op == 0x0:                                               # CPSE
+                self.cycles += 1
+                if r[d] == r[s]:
+                    n = self.skipSize()
+                    self.pc += n
+                    self.cycles += n
+                return
+            if op == 0x1:                                               # CP
+                self.sub(r[d], r[s], 0)
+            elif op == 0x2:                                             # SUB
+                r[d] = self.sub(r[d], r[s], 0)
+            else:                                                       # ADC
+                r[d] = self.add(r[d], r[s], self.flag(FLAG_C))
+            self.cycles += 1
+            return
+        if hi == 0x2:
+            d = (w >> 4) & 0x1f
+            s = (w & 0xf) | ((w >> 5) & 0x10)
+            op = (w >> 10) & 0x3
+            if op == 0x0:                                               # AND
+                r[d] = self.logic(r[d] & r[s])
+            elif op == 0x1:                                             # EOR
+                r[d] = self.logic(r[d] ^ r[s])
+            elif op == 0x2:                                             # OR
+                r[d] = self.logic(r[d] | r[s])
+            else:                                                       # MOV
+                r[d] = r[s]
+            self.cycles += 1
+            return
+        if hi <= 0x7 or hi == 0xe:
+            d = 16 + ((w >> 4) & 0xf)
+            k = ((w >> 4) & 0xf0) | (w & 0xf)
+            if hi == 0x3:                                               # CPI
+                self.sub(r[d], k, 0)
+            elif hi == 0x4:                                             # SBCI
+                r[d] = self.sub(r[d], k, self.flag(FLAG_C), True)
+            elif hi == 0x5:                                             # SUBI
+                r[d] = self.sub(r[d], k, 0)
+            elif hi == 0x6:                                             # ORI
+                r[d] = self.logic(r[d] | k)
+            elif hi == 0x7:                                             # ANDI
+                r[d] = self.logic(r[d] & k)
+            else:                                                       # LDI
+                r[d] = k
+            self.cycles += 1
+            return
+        if hi == 0x8 or hi == 0xa:                                      # LDD, STD
+            d = (w >> 4) & 0x1f
+            q = (w & 0x7) | ((w >> 7) & 0x18) | ((w >> 8) & 0x20)
+            base = self.pair(28) if (w & 0x8) else self.pair(30)
+            if w & 0x200:
+                self.write(base + q, r[d])
+                self.cycles += 1
+            else:
+                r[d] = self.read(base + q)
+                self.cycles += 2
+            return
+        if hi == 0x9:
+            self.step9(w)
+            return
+        if hi == 0xb:
+            d = (w >> 4) & 0x1f
+            a = (w & 0xf) | ((w >> 5) & 0x30)
+            if w & 0x800:                                               # OUT
+                self.write(a, r[d])
+            else:                                                       # IN
+                r[d] = self.read(a)
+            self.cycles += 1
+            return
+        if hi == 0xc or hi == 0xd:                                      # RJMP, RCALL
+            k = w & 0xfff
+            if k & 0x800:
+                k -= 0x1000
+            if hi == 0xd:
+                self.pushPc(self.pc)
+            self.pc = (self.pc + k) & 0xffff
+            self.cycles += 2
+            return
+        # hi == 0xf
+        op = (w >> 9) & 0x7
+        if op <= 0x3:                                                   # BRBS, BRBC
+            k = (w >> 3) & 0x7f
+            if k & 0x40:
+                k -= 0x80
+            bit = self.flag(w & 0x7)
+            if bit == (0 if (w & 0x400) else 1):
+                self.pc = (self.pc + k) & 0xffff
+                self.cycles += 2
+            else:
+                self.cycles += 1
+            return
+        d = (w >> 4) & 0x1f
+        b = w & 0x7
+        if op == 0x4:                                                   # BLD
+            r[d] = (r[d] | (1 << b)) if self.flag(FLAG_T) else (r[d] & ~(1 << b))
+            self.cycles += 1
+        elif op == 0x5:                                                 # BST
+            self.setFlags(T = (r[d] >> b) & 1)
+            self.cycles += 1
+        else:                                                           # SBRC, SBRS
+            self.cycles += 1
+            if ((r[d] >> b) & 1) == (op == 0x7):
+                n = self.skipSize()
+                self.pc += n
+                self.cycles += n
+
+    def step9(self, w):
+        r = self.r
+        op = (w >> 8) & 0xf
+        if op <= 0x3:
+            d = (w >> 4) & 0x1f
+            mode = w & 0xf
+            store = op >= 0x2
+            if mode == 0x0:                                             # LDS, STS
+                addr = self.fetch(self.pc)
+                self.pc += 1
+                if store:
+                    self.write(addr, r[d])
+                    self.cycles += 2
+                else:
+                    r[d] = self.read(addr)
+                    self.cycles += 3
+                return
+            if mode == 0xf:                                             # PUSH, POP
+                if store:
+                    self.push(r[d])
+                    self.cycles += 1
+                else:
+                    r[d] = self.pop()
+                    self.cycles += 2
+                return
+            if not store and mode in (0x4, 0x5):                        # LPM Rd, Z(+)
+                z = self.pair(30)
+                r[d] = self.flash[z] if z < len(self.flash) else 0xff
+                if mode == 0x5:
+                    self.setPair(30, z + 1)
+                self.cycles += 3
+                return
+            if mode in (0x1, 0x2):
+                reg = 30
+            elif mode in (0x9, 0xa):
+                reg = 28
+            elif mode in (0xc, 0xd, 0xe):
+                reg = 26
+            else:
+                raise SimError("unsupported instruction {:04x} at {:04x}".format(w, (self.pc - 1) * 2))
+            addr = self.pair(reg)
+            predec = mode in (0x2, 0xa, 0xe)
+            postinc = mode in (0x1, 0x9, 0xd)
+            if predec:
+                addr = (addr - 1) & 0xffff
+                self.setPair(reg, addr)
+            if store:
+                self.write(addr, r[d])
+                self.cycles += 1
+            else:
+                r[d] = self.read(addr)
+                self.cycles += 2
+            if postinc:
+                self.setPair(reg, addr + 1)
+            return
+        if op == 0x4 or op == 0x5:
+            if (w & 0xe) == 0xc or (w & 0xe) == 0xe:                    # JMP, CALL
+                k = self.fetch(self.pc) | (((w >> 3) & 0x3e | (w & 0x1)) << 16)
+                self.pc += 1
+                if w & 0x2:
+                    self.pushPc(self.pc)
+                self.pc = k
+                self.cycles += 3
+                return
+            low = w & 0xf
+            if low == 0x8:
+                if op == 0x4:                                           # BSET, BCLR
+                    bit = (w >> 4) & 0x7
+                    if w & 0x80:
+                        self.sreg &= ~(1 << bit) & 0xff
+                    else:
+                        self.sreg |= 1 << bit
+                    self.cycles += 1
+                    return
+                sub = (w >> 4) & 0xf
+                if sub == 0x0 or sub == 0x1:                            # RET, RETI
+                    self.pc = self.popPc()
+                    if sub == 0x1:
+                        self.sreg |= 1 << FLAG_I
+                    self.cycles += 4
+                    return
+                if sub == 0x8:                                          # SLEEP
+                    self.cycles += 1
+                    if not self.flag(FLAG_I):
+                        raise SimError("sleep with interrupts disabled at {:04x}".format((self.pc - 1) * 2))
+                    return
+                if sub == 0x9:                                          # BREAK
+                    raise SimError("break at {:04x}".format((self.pc - 1) * 2))
+                if sub == 0xa:                                          # WDR
+                    self.cycles += 1
+                    return
+                if sub == 0xc:                                          # LPM
+                    z = self.pair(30)
+                    r[0] = self.flash[z] if z < len(self.flash) else 0xff
+                    self.cycles += 3
+                    return
+                raise SimError("unsupported instruction {:04x} at {:04x}".format(w, (self.pc - 1) * 2))
+            if low == 0x9:                                              # IJMP, ICALL
+                if w & 0xf0:
+                    raise SimError("unsupported instruction {:04x} at {:04x}".format(w, (self.pc - 1) * 2))
+                if op == 0x5:
+                    self.pushPc(self.pc)
+                self.pc = self.pair(30)
+                self.cycles += 2
+                return
+            d = (w >> 4) & 0x1f
+            v = r[d]
+            if low == 0x0:                                              # COM
+                res = ~v & 0xff
+                self.setFlags(V = 0, N = res >> 7, Z = res == 0, C = 1)
+            elif low == 0x1:                                            # NEG
+                res = (-v) & 0xff
+                self.setFlags(H = ((res | v) >> 3) & 1, V = res == 0x80, N = res >> 7, Z = res == 0, C = res != 0)
+            elif low == 0x2:                                            # SWAP
+                res = ((v << 4) | (v >> 4)) & 0xff
+            elif low == 0x3:                                            # INC
+                res = (v + 1) & 0xff
+                self.setFlags(V = res == 0x80, N = res >> 7, Z = res == 0)
+            elif low == 0x5:                                            # ASR
+                res = (v >> 1) | (v & 0x80)
+                c = v & 1
+                n = res >> 7
+                self.setFlags(N = n, Z = res == 0, C = c, V = n ^ c)
+            elif low == 0x6:                                            # LSR
+                res = v >> 1
+                c = v & 1
+                self.setFlags(N = 0, Z = res == 0, C = c, V = c)
+            elif low == 0x7:                                            # ROR
+                res = (v >> 1) | (self.flag(FLAG_C) << 7)
+                c = v & 1
+                n = res >> 7
+                self.setFlags(N = n, Z = res == 0, C = c, V = n ^ c)
+            elif low == 0xa:                                            # DEC
+                res = (v - 1) & 0xff
+                self.setFlags(V = res == 0x7f, N = res >> 7, Z = res == 0)
+            else:
+                raise SimError("unsupported instruction {:04x} at {:04x}".format(w, (self.pc - 1) * 2))
+            r[d] = res
+            self.cycles += 1
+            return
+        if op == 0x6 or op == 0x7:                                      # ADIW, SBIW
+            d = 24 + ((w >> 4) & 0x3) * 2
+            k = (w & 0xf) | ((w >> 2) & 0x30)
+            v = self.pair(d)
+            if op == 0x6:
+                res = (v + k) & 0xffff
+                self.setFlags(V = (~v & res) >> 15 & 1, N = res >> 15, Z = res == 0, C = (~res & v) >> 15 & 1)
+            else:
+                res = (v - k) & 0xffff
+                self.setFlags(V = (v & ~res) >> 15 & 1, N = res >> 15, Z = res == 0, C = (res & ~v) >> 15 & 1)
+            self.setPair(d, res)
+            self.cycles += 2
+            return
+        if op <= 0xb:                                                   # CBI, SBIC, SBI, SBIS
+            a = (w >> 3) & 0x1f
+            b = w & 0x7
+            if op == 0x8 or op == 0xa:
+                v = self.read(a)
+                self.write(a, (v | (1 << b)) if op == 0xa else (v & ~(1 << b)))
+                self.cycles += 1
+            else:
+                self.cycles += 1
+                if ((self.read(a) >> b) & 1) == (op == 0xb):
+                    n = self.skipSize()
+                    self.pc += n
+                    self.cycles += n
+            return
+        # MUL
+        d = (w >> 4) & 0x1f
+        s = (w & 0xf) | ((w >> 5) & 0x10)
+        self.mul(r[d] * r[s], False)
+
+    def mul(self, product, fractional):
+        product &= 0xffff
+        c = product >> 15
+        if fractional:
+            product = (product << 1) & 0xffff
+        self.r[0] = product & 0xff
+        self.r[1] = product >> 8
+        self.setFlags(C = c, Z = product == 0)
+        self.cycles += 2
+
+    @staticmethod
+    def signed(v):
+        return v - 256 if v & 0x80 else v
+
+    def pair(self, reg):
+        return self.r[reg] | (self.r[reg + 1] << 8)
+
+    def setPair(self, reg, value):
+        self.r[reg] = value & 0xff
+        self.r[reg + 1] = (value >> 8) & 0xff
+
+
+def main():
+    parser = argparse.ArgumentParser(description = "Runs an ATtiny1604 firmware in the AVRxt simulator and reports its exit status and cycles.")
+    parser.add_argument("elf")
+    parser.add_argument("--max-cycles", type = int, default = 10000000)
+    args = parser.parse_args()
+    sim = Sim(load_elf(args.elf))
+    try:
+        status = sim.run(args.max_cycles)
+    except SimError as e:
+        sys.exit("{}: {}".format(args.elf, e))
+    print("exit {} after {} cycles".format(status, sim.cycles))
+    sys.exit(status)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,121 @@
+#!/usr/bin/env python3
+"""Benchmarks of the firmware hot paths.
+
+Builds bench/bench.cpp for the ATtiny1604 with avr-g++ on the bare-metal platform (include/platform/baremetal.h), i.e. the very platform code the baremetal environment ships, runs it in the AVRxt simulator (bin/avrsim.py) and reports the exact cycles and the stack used by every benchmark. The results are compared against bench/baseline.json and the script fails if any benchmark takes more cycles or stack than its baseline. Since the simulation is deterministic, any increase is a regression, and so is a missing baseline, or a benchmark missing from it, as nothing would be checked then. It also fails if a benchmark takes more cycles than the budget the firmware gives the benchmarked code, e.g. an effect's BUDGET, so that the budgets follow the measured cycles.
+
+Usage: bench.py [--update] [--cc avr-g++] [--f-cpu 8000000]
+
+    --update    stores the results as the new baseline, which must be committed with the change that caused them
+
+The compiler must know the ATtiny1604, e.g. the one from megaTinyCore, or PlatformIO's toolchain-atmelavr:
+
+    bench.py --cc ~/.platformio/packages/toolchain-atmelavr/bin/avr-g++
+"""
+
+import argparse
+import json
+import os
+import re
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import avrsim
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+BENCH = os.path.join(ROOT, "bench")
+BASELINE = os.path.join(BENCH, "baseline.json")
+
+
+def build(cc, source, output, f_cpu, defines = []):
+    """Builds the given source of the bench directory into an ELF file."""
+    cmd = [cc, "-mmcu=attiny1604", "-DF_CPU={}L".format(f_cpu), "-DARCH_AVR_BAREMETAL", "-Os", "-std=gnu++17",
+        "-fno-exceptions", "-fno-threadsafe-statics", "-ffunction-sections", "-fdata-sections", "-Wl,--gc-sections",
+        "-I" + os.path.join(ROOT, "include")]
+    cmd += ["-D" + d for d in defines]
+    cmd += [os.path.join(BENCH, source), "-o", output]
+    subprocess.run(cmd, check = True)
+
+
+def benchmarks(source):
+    """Returns the benchmark names by id, parsed from the Bench enum."""
+    with open(os.path.join(BENCH, source)) as f:
+        text = f.read()
+    enum = re.search(r"enum class Bench[^{]*\{([^}]*)\}", text).group(1)
+    return { int(id) : name for name, id in re.findall(r"(\w+)\s*=\s*(\d+)", enum) }
+
+
+def run(elf, names):
+    """Runs the benchmarks, returns their worst case cycles, stack use and cycle budget (0 for none) by name."""
+    sim = avrsim.Sim(avrsim.load_elf(elf))
+    budget = avrsim.load_symbols(elf)["budget"] & 0xffff
+    results = {}
+    current = {}
+
+    def start(id):
+        current["start"] = sim.cycles
+        current["sp"] = sim.sp
+        current["budget"] = sim.read(budget) | sim.read(budget + 1) << 8
+        sim.minSp = sim.sp
+
+    def end(id):
+        cycles = sim.cycles - current["start"]
+        stack = current["sp"] - sim.minSp
+        name = names.get(id, "bench{}".format(id))
+        old = results.get(name, (0, 0, 0))
+        results[name] = (max(old[0], cycles), max(old[1], stack), max(old[2], current["budget"]))
+
+    sim.onStart = start
+    sim.onEnd = end
+    status = sim.run()
+    if status != 0:
+        raise avrsim.SimError("benchmark exited with {}".format(status))
+    # the markers themselves take a few cycles, which the empty benchmark measures
+    overhead = results.pop("Overhead", (0, 0, 0))[0]
+    return { name : { "cycles" : cycles - overhead, "stack" : stack, "budget" : budget } for name, (cycles, stack, budget) in results.items() }
+
+
+def main():
+    parser = argparse.ArgumentParser(description = "Runs the benchmarks of the firmware hot paths in the AVRxt simulator.")
+    parser.add_argument("--cc", default = "avr-g++")
+    parser.add_argument("--f-cpu", type = int, default = 8000000)
+    parser.add_argument("--update", action = "store_true", help = "store the results as the new baseline")
+    args = parser.parse_args()
+    if not args.update and not os.path.exists(BASELINE):
+        sys.exit("bench: {} is missing, create it with --update".format(os.path.relpath(BASELINE)))
+    os.makedirs(os.path.join(ROOT, ".bench"), exist_ok = True)
+    elf = os.path.join(ROOT, ".bench", "bench.elf")
+    build(args.cc, "bench.cpp", elf, args.f_cpu)
+    try:
+        results = run(elf, benchmarks("bench.cpp"))
+    except avrsim.SimError as e:
+        sys.exit("bench: {}".format(e))
+    baseline = {}
+    if os.path.exists(BASELINE):
+        with open(BASELINE) as f:
+            baseline = json.load(f)
+    regressions = False
+    overBudget = False
+    print("{:24} {:>8} {:>8} {:>8} {:>6} {:>6}".format("benchmark", "cycles", "base", "budget", "stack", "base"))
+    for name, r in results.items():
+        base = baseline.get(name, {})
+        regressed = not base or r["cycles"] > base["cycles"] or r["stack"] > base["stack"]
+        over = r["budget"] != 0 and r["cycles"] > r["budget"]
+        regressions = regressions or regressed
+        overBudget = overBudget or over
+        print("{:24} {:>8} {:>8} {:>8} {:>6} {:>6}{}{}".format(name, r["cycles"], base.get("cycles", "-"), r["budget"] or "-", r["stack"], base.get("stack", "-"),
+            ("  REGRESSION" if base else "  NOT IN BASELINE") if regressed else "", "  OVER BUDGET" if over else ""))
+    if args.update:
+        with open(BASELINE, "w") as f:
+            json.dump({ name : { "cycles" : r["cycles"], "stack" : r["stack"] } for name, r in results.items() }, f, indent = 4, sort_keys = True)
+            f.write("\n")
+        print("baseline updated")
+    elif regressions:
+        sys.exit("bench: regressions against {}".format(os.path.relpath(BASELINE)))
+    # the budgets are in the firmware, a new baseline does not fix them
+    if overBudget:
+        sys.exit("bench: benchmarks over the budget the firmware gives them")
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,190 @@
+#!/usr/bin/env python3
+"""Cue file compiler.
+
+Compiles a text cue file into the bytecode run by CuePlayer (include/utils/cues.h) and writes it as a header with the program in PROGMEM.
+
+Cue file syntax, one instruction per line. Lines starting with # are comments, // starts a comment anywhere:
+
+    name:                   label, target of jump
+    white LEVEL [TIME]      fade white to LEVEL (0-255) over TIME
+    rgb COLOR [TIME]        fade RGB to COLOR (#rrggbb or r,g,b) over TIME
+    wait TIME               hold for TIME
+    effect NAME             none, candle or lightning (or a number)
+    button NAME[,NAME]      wait for left and/or right effect button
+    jump LABEL              continue at the label
+    end                     stop the show
+
+TIME is in ticks (10ms) unless suffixed by ms or s, e.g. 250ms, 1.5s. Fades without TIME are immediate.
+
+The player executes at most MAX_STEPS instructions per tick, so the instructions from a wait or button to the next one (following jumps, and counting the wait itself) must not be more than that, or the rest would run a tick late. Such programs are rejected.
+
+Usage: cuec.py input.cue output.h [--name SHOW_CUES] [--tick-ms 10]
+"""
+
+import argparse
+import os
+import sys
+
+OP_END = 0
+OP_WAIT = 1
+OP_WHITE = 2
+OP_RGB = 3
+OP_EFFECT = 4
+OP_BUTTON = 5
+OP_JUMP = 6
+
+# must match CuePlayer::MAX_STEPS in include/utils/cues.h
+MAX_STEPS = 4
+
+# must match the CUE_EFFECT_ and CUE_BUTTON_ constants in src/main.cpp
+EFFECTS = { "none" : 0, "candle" : 1, "lightning" : 2 }
+BUTTONS = { "left" : 1, "right" : 2 }
+
+
+class CueError(Exception):
+    pass
+
+
+def parse_byte(text):
+    value = int(text, 0)
+    if value < 0 or value > 255:
+        raise CueError("value {} out of range 0-255".format(text))
+    return value
+
+
+def parse_time(text, tick_ms):
+    if text.endswith("ms"):
+        ticks = round(float(text[:-2]) / tick_ms)
+    elif text.endswith("s"):
+        ticks = round(float(text[:-1]) * 1000 / tick_ms)
+    else:
+        ticks = int(text, 0)
+    if ticks < 0 or ticks > 65535:
+        raise CueError("time {} out of range".format(text))
+    return ticks
+
+
+def parse_color(text):
+    if text.startswith("#"):
+        if len(text) != 7:
+            raise CueError("invalid color {}".format(text))
+        return [int(text[i:i + 2], 16) for i in (1, 3, 5)]
+    parts = text.split(",")
+    if len(parts) != 3:
+        raise CueError("invalid color {}".format(text))
+    return [parse_byte(p) for p in parts]
+
+
+def word(value):
+    return [value & 0xff, (value >> 8) & 0xff]
+
+
+def check_steps(code, lines):
+    """Checks that every run of instructions the player executes in one tick fits MAX_STEPS. The runs start at the program start and after each wait and button, and end with the first wait, button or end they reach. lines maps the offset of each instruction to its line."""
+    def length(pc):
+        return { OP_WAIT : 3, OP_WHITE : 4, OP_RGB : 6, OP_EFFECT : 2, OP_BUTTON : 2, OP_JUMP : 3 }.get(code[pc], 1)
+
+    def waits(pc):
+        return code[pc] == OP_BUTTON or code[pc] == OP_END or (code[pc] == OP_WAIT and (code[pc + 1] or code[pc + 2]))
+
+    entries = [0] + [pc + length(pc) for pc in lines if waits(pc) and code[pc] != OP_END and pc + length(pc) < len(code)]
+    for entry in entries:
+        pc = entry
+        for steps in range(MAX_STEPS):
+            if waits(pc):
+                break
+            pc = code[pc + 1] | (code[pc + 2] << 8) if code[pc] == OP_JUMP else pc + length(pc)
+        else:
+            raise CueError("line {}: more than {} instructions before the next wait, the rest would run a tick late".format(lines.get(entry, "end"), MAX_STEPS))
+
+
+def compile_cues(lines, tick_ms):
+    """Returns the bytecode. Jumps are resolved in a second pass once all labels are known."""
+    code = []
+    labels = {}
+    fixups = []
+    # line of the instruction at each offset
+    source = {}
+    for lineno, line in enumerate(lines, 1):
+        line = line.split("//", 1)[0].strip()
+        if not line or line.startswith("#"):
+            continue
+        try:
+            if line.endswith(":"):
+                label = line[:-1].strip()
+                if label in labels:
+                    raise CueError("duplicate label {}".format(label))
+                labels[label] = len(code)
+                continue
+            source[len(code)] = lineno
+            args = line.split()
+            cmd = args[0].lower()
+            args = args[1:]
+            if cmd == "white" and len(args) in (1, 2):
+                code += [OP_WHITE, parse_byte(args[0])] + word(parse_time(args[1], tick_ms) if len(args) == 2 else 0)
+            elif cmd == "rgb" and len(args) in (1, 2):
+                code += [OP_RGB] + parse_color(args[0]) + word(parse_time(args[1], tick_ms) if len(args) == 2 else 0)
+            elif cmd == "wait" and len(args) == 1:
+                code += [OP_WAIT] + word(parse_time(args[0], tick_ms))
+            elif cmd == "effect" and len(args) == 1:
+                name = args[0].lower()
+                code += [OP_EFFECT, EFFECTS[name] if name in EFFECTS else parse_byte(name)]
+            elif cmd == "button" and len(args) == 1:
+                mask = 0
+                for name in args[0].lower().split(","):
+                    if name not in BUTTONS:
+                        raise CueError("unknown button {}".format(name))
+                    mask |= BUTTONS[name]
+                code += [OP_BUTTON, mask]
+            elif cmd == "jump" and len(args) == 1:
+                code += [OP_JUMP, 0, 0]
+                fixups.append((len(code) - 2, args[0], lineno))
+            elif cmd == "end" and len(args) == 0:
+                code += [OP_END]
+            else:
+                raise CueError("invalid instruction: {}".format(line))
+        except (CueError, ValueError) as e:
+            raise CueError("line {}: {}".format(lineno, e))
+    for offset, label, lineno in fixups:
+        if label not in labels:
+            raise CueError("line {}: unknown label {}".format(lineno, label))
+        code[offset:offset + 2] = word(labels[label])
+    # make sure the program always ends
+    if not code or code[max(source)] != OP_END:
+        source[len(code)] = len(lines)
+        code.append(OP_END)
+    check_steps(code, source)
+    if len(code) > 65535:
+        raise CueError("program too large")
+    return code
+
+
+def write_header(code, name, source, out):
+    out.write("#pragma once\n")
+    out.write("// Generated by bin/cuec.py from {}, do not edit.\n\n".format(source))
+    out.write("#include \"platform/platform.h\"\n\n")
+    out.write("constexpr uint8_t {}[] PROGMEM = {{\n".format(name))
+    for i in range(0, len(code), 16):
+        out.write("    " + ", ".join("0x{:02x}".format(b) for b in code[i:i + 16]) + ",\n")
+    out.write("};\n")
+
+
+def main():
+    parser = argparse.ArgumentParser(description = "Compiles a cue file into a header with the show bytecode.")
+    parser.add_argument("input")
+    parser.add_argument("output")
+    parser.add_argument("--name", default = "SHOW_CUES")
+    parser.add_argument("--tick-ms", type = float, default = 10)
+    args = parser.parse_args()
+    with open(args.input) as f:
+        try:
+            code = compile_cues(f.readlines(), args.tick_ms)
+        except CueError as e:
+            sys.exit("{}: {}".format(args.input, e))
+    with open(args.output, "w") as f:
+        write_header(code, args.name, os.path.relpath(args.input), f)
+    print("{} bytes".format(len(code)))
+
+
+if __name__ == "__main__":
+    main()
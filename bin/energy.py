@@ -0,0 +1,37 @@
+#!/usr/bin/env python3
+"""Battery life estimate of the light for a usage script.
+
+Builds bench/energy.cpp for the host with the mock platform (include/platform/mock.h) and runs the firmware on the given usage script in simulated time. Reports the charge consumed per mode and per load, and the projected runtime of the battery. See bench/energy.cpp for the script format and bench/usage for examples.
+
+Usage: energy.py SCRIPT [--capacity 1000] [--cxx c++] [-D FLAG ...]
+
+    --capacity  battery capacity in mAh
+    -D          extra build flags of the firmware, e.g. -D CUE_SHOW, or -D DEFAULT_BRIGHTNESS_WHITE=16 to judge a different default
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+
+def main():
+    parser = argparse.ArgumentParser(description = "Estimates the battery life of the light for a usage script.")
+    parser.add_argument("script")
+    parser.add_argument("--capacity", type = float, default = 1000, help = "battery capacity in mAh")
+    parser.add_argument("--cxx", default = "c++")
+    parser.add_argument("-D", dest = "defines", action = "append", default = [], help = "extra build flags of the firmware")
+    args = parser.parse_args()
+    os.makedirs(os.path.join(ROOT, ".bench"), exist_ok = True)
+    exe = os.path.join(ROOT, ".bench", "energy")
+    cmd = [args.cxx, "-std=c++17", "-O2", "-DARCH_MOCK", "-DF_CPU=8000000L", "-I" + os.path.join(ROOT, "include")]
+    cmd += ["-D" + d for d in args.defines]
+    cmd += [os.path.join(ROOT, "bench", "energy.cpp"), "-o", exe]
+    subprocess.run(cmd, check = True)
+    sys.exit(subprocess.run([exe, args.script, str(args.capacity)]).returncode)
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,126 @@
+#!/usr/bin/env python3
+"""Compares the footprint of the Arduino core and bare-metal builds.
+
+Builds the given PlatformIO environments (by default rcboy-avr, i.e. megaTinyCore, and baremetal, see include/platform/baremetal.h) and reports for each:
+
+    flash   bytes of the text, read only data and initialized data
+    RAM     bytes of the initialized and zeroed data, without the stack
+    wake    cycles of the PORTA interrupt, i.e. the mode buttons waking the CPU up, from the vector to reti
+
+The wake cycles are measured in the AVRxt simulator (bin/avrsim.py) after the startup code has run, without the 2 cycle interrupt response and the oscillator start-up, which are the same for all builds. The flags of the white mode button (PA4) are set.
+
+Usage: footprint.py [--no-build] [ENV ...]
+"""
+
+import argparse
+import os
+import struct
+import subprocess
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import avrsim
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# PORTA_PORT_vect of the ATtiny1604
+PORTA_VECTOR = "__vector_3"
+PORTA_INTFLAGS = 0x0409
+PIN_WHITE_MODE = 0x10
+
+DATA_SPACE = 0x800000
+SRAM_SIZE = 1024
+FLASH_SIZE = 16 * 1024
+
+
+def sections(path):
+    """Returns (name, address, size, type) of the allocated sections of the ELF file."""
+    with open(path, "rb") as f:
+        elf = f.read()
+    shoff, = struct.unpack_from("<I", elf, 32)
+    shentsize, shnum, shstrndx = struct.unpack_from("<HHH", elf, 46)
+    headers = [struct.unpack_from("<IIIIIIIIII", elf, shoff + i * shentsize) for i in range(shnum)]
+    strtab = headers[shstrndx][4]
+    result = []
+    for name, stype, flags, addr, offset, size, link, info, align, entsize in headers:
+        # SHF_ALLOC
+        if flags & 2 and size > 0:
+            end = elf.index(b"\0", strtab + name)
+            result.append((elf[strtab + name:end].decode(), addr, size, stype))
+    return result
+
+
+def footprint(path):
+    """Returns the flash and RAM bytes used by the ELF file."""
+    flash = 0
+    ram = 0
+    for name, addr, size, stype in sections(path):
+        if addr < DATA_SPACE:
+            flash += size
+        elif addr >= DATA_SPACE + avrsim.SRAM_START and addr <= DATA_SPACE + avrsim.RAMEND:
+            ram += size
+            # initialized data is stored in the flash too, SHT_NOBITS is not
+            if stype != 8:
+                flash += size
+        elif addr >= DATA_SPACE + avrsim.FLASH_MAPPED and addr < DATA_SPACE + 0x10000:
+            # read only data the linker leaves in the flash mapped into the data space
+            flash += size
+    return flash, ram
+
+
+def wakeCycles(path):
+    """Returns the cycles of the PORTA interrupt handler, measured in the simulator."""
+    symbols = avrsim.load_symbols(path)
+    if PORTA_VECTOR not in symbols:
+        return None
+    sim = avrsim.Sim(avrsim.load_elf(path))
+    # run the startup code, which initializes the data and bss
+    mainPc = symbols["main"] // 2
+    while sim.pc != mainPc:
+        if sim.cycles > 100000:
+            raise avrsim.SimError("startup code did not reach main")
+        sim.step()
+    sim.data[PORTA_INTFLAGS] = PIN_WHITE_MODE
+    # call the handler as the interrupt would, returning to main
+    sim.pushPc(sim.pc)
+    sim.pc = symbols[PORTA_VECTOR] // 2
+    start = sim.cycles
+    while sim.pc != mainPc:
+        if sim.cycles - start > 10000:
+            raise avrsim.SimError("the PORTA interrupt did not return")
+        sim.step()
+    return sim.cycles - start
+
+
+def main():
+    parser = argparse.ArgumentParser(description = "Compares the flash, RAM and wake up cost of PlatformIO builds.")
+    parser.add_argument("envs", nargs = "*", default = ["rcboy-avr", "baremetal"])
+    parser.add_argument("--no-build", action = "store_true", help = "use the existing builds")
+    args = parser.parse_args()
+    if not args.no_build:
+        cmd = ["pio", "run", "-d", ROOT]
+        for env in args.envs:
+            cmd += ["-e", env]
+        subprocess.run(cmd, check = True)
+    results = []
+    for env in args.envs:
+        elf = os.path.join(ROOT, ".pio", "build", env, "firmware.elf")
+        flash, ram = footprint(elf)
+        try:
+            wake = wakeCycles(elf)
+        except avrsim.SimError as e:
+            print("{}: {}".format(env, e), file = sys.stderr)
+            wake = None
+        results.append((env, flash, ram, wake))
+    print("{:16} {:>14} {:>14} {:>8}".format("env", "flash", "RAM", "wake"))
+    for env, flash, ram, wake in results:
+        print("{:16} {:>6} ({:4.1f}%) {:>6} ({:4.1f}%) {:>8}".format(env, flash, flash * 100 / FLASH_SIZE, ram, ram * 100 / SRAM_SIZE,
+            "-" if wake is None else wake))
+    base = results[0]
+    for env, flash, ram, wake in results[1:]:
+        print("{} saves {} bytes of flash, {} bytes of RAM{}".format(env, base[1] - flash, base[2] - ram,
+            "" if wake is None or base[3] is None else " and {} cycles of wake up".format(base[3] - wake)))
+
+
+if __name__ == "__main__":
+    main()
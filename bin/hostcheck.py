@@ -0,0 +1,71 @@
+#!/usr/bin/env python3
+"""Runs the host checks of the firmware.
+
+Builds the given checks of the bench directory (by default all of them) for the host with the mock platform (include/platform/mock.h), runs them and fails if any of them does. Each prints its failed checks, see bench/check.h:
+
+    registers   the I2C slave and serial register files, see bench/registers.cpp
+    limit       the channel sum kept by ColorStrip and the neopixel current limit, see bench/limit.cpp
+    resume      the time the light takes to come on after waking up from sleep, built with I2C_CONTROL, see bench/resume.cpp
+    hsv         the table driven HSV conversion against the exact one for all inputs, see bench/hsv.cpp
+
+Usage: hostcheck.py [--cxx c++] [--max-latency 10] [--tolerance 0] [-D FLAG ...] [CHECK ...]
+
+    --max-latency   longest wakeup in milliseconds, one 10ms tick by default
+    --tolerance     largest difference of a channel between the HSV conversions
+    -D              extra build flags of the firmware
+"""
+
+import argparse
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+# name: build flags of the check
+CHECKS = {
+    "registers" : [],
+    "limit" : [],
+    "resume" : ["I2C_CONTROL"],
+    "hsv" : [],
+}
+
+
+def build(cxx, name, defines):
+    """Builds the check for the host, returns the path of the executable."""
+    exe = os.path.join(ROOT, ".bench", name)
+    cmd = [cxx, "-std=c++17", "-O2", "-DARCH_MOCK", "-DF_CPU=8000000L", "-I" + os.path.join(ROOT, "include")]
+    cmd += ["-D" + d for d in CHECKS[name] + defines]
+    cmd += [os.path.join(ROOT, "bench", name + ".cpp"), "-o", exe]
+    subprocess.run(cmd, check = True)
+    return exe
+
+
+def main():
+    parser = argparse.ArgumentParser(description = "Runs the host checks of the firmware.")
+    parser.add_argument("checks", nargs = "*", metavar = "CHECK", help = "one of {}".format(", ".join(CHECKS)))
+    parser.add_argument("--cxx", default = "c++")
+    parser.add_argument("--max-latency", type = float, default = 10, help = "in milliseconds")
+    parser.add_argument("--tolerance", type = int, default = 0, help = "largest difference of a channel allowed")
+    parser.add_argument("-D", dest = "defines", action = "append", default = [], help = "extra build flags of the firmware")
+    args = parser.parse_args()
+    for name in args.checks:
+        if name not in CHECKS:
+            parser.error("unknown check {}".format(name))
+    arguments = {
+        "resume" : [str(int(args.max_latency * 1000))],
+        "hsv" : [str(args.tolerance)],
+    }
+    os.makedirs(os.path.join(ROOT, ".bench"), exist_ok = True)
+    failed = []
+    for name in args.checks or CHECKS:
+        print("{}:".format(name))
+        exe = build(args.cxx, name, args.defines)
+        if subprocess.run([exe] + arguments.get(name, [])).returncode != 0:
+            failed.append(name)
+    if failed:
+        sys.exit("hostcheck: {} failed".format(", ".join(failed)))
+
+
+if __name__ == "__main__":
+    main()
@@ -0,0 +1,123 @@
+#!/usr/bin/env python3
+"""Checks that lights on the sync wire stay in step.
+
+Builds bench/sync.cpp for the host with the mock platform as the SYNC_LEADER and as a SYNC_FOLLOWER, runs the leader and then the followers on its beacons, each powered up at a different time and with a different clock error (see bench/sync.cpp). Reports for every follower
+
+    lock    when it first ran the leader's timebase
+    phase   the largest and average difference between the start of the same tick of the timebase on the follower and on the leader, after the lock
+    late    the ticks started more than a frame (10ms) from the leader's, after the lock
+    same    the ticks after the lock and the effect's fade (0.5s) that showed the same as the leader, i.e. the same hue and color for the rainbow, the same white level for the candle
+
+and fails if any follower is more than a frame off.
+
+Usage: sync.py [--effect rainbow|candle] [--time 20] [--follower START_MS:CLOCK_PPM ...] [--cxx c++] [-D FLAG ...]
+"""
+
+import argparse
+import bisect
+import os
+import subprocess
+import sys
+
+ROOT = os.path.dirname(os.path.dirname(os.path.abspath(__file__)))
+
+FRAME_US = 10000
+FADE_US = 500000
+
+# powered up at different times, clocks off by up to 2%
+FOLLOWERS = ["130:20000", "470:-20000", "1900:5000"]
+
+
+def build(cxx, role, defines):
+    exe = os.path.join(ROOT, ".bench", "sync-" + role.lower())
+    cmd = [cxx, "-std=c++17", "-O2", "-DARCH_MOCK", "-DF_CPU=8000000L", "-DSYNC_" + role, "-I" + os.path.join(ROOT, "include")]
+    cmd += ["-D" + d for d in defines]
+    cmd += [os.path.join(ROOT, "bench", "sync.cpp"), "-o", exe]
+    subprocess.run(cmd, check = True)
+    return exe
+
+
+def run(cmd):
+    """Returns the ticks the light printed as (time, ticks, hue, white, (r, g, b)) tuples."""
+    output = subprocess.run([str(x) for x in cmd], check = True, stdout = subprocess.PIPE, universal_newlines = True).stdout
+    result = []
+    for line in output.splitlines():
+        time, ticks, hue, white, r, g, b = (int(x) for x in line.split())
+        result.append((time, ticks, hue, white, (r, g, b)))
+    return result
+
+
+def compare(leader, follower, effect):
+    """Returns the lock time, the phase differences after the lock and the number of ticks showing the same as the leader, and the number of ticks compared."""
+    # the ticks of the leader with given timebase, as the timebase wraps around
+    byTicks = {}
+    for tick in leader:
+        byTicks.setdefault(tick[1], []).append(tick)
+    lock = None
+    phases = []
+    same = 0
+    compared = 0
+    for time, ticks, hue, white, color in follower:
+        # the leader's run ends first, when the follower's clock is fast
+        if time > leader[-1][0]:
+            break
+        candidates = byTicks.get(ticks, [])
+        if not candidates:
+            continue
+        times = [t[0] for t in candidates]
+        i = bisect.bisect_left(times, time)
+        nearest = min(candidates[max(i - 1, 0):i + 1], key = lambda t: abs(t[0] - time))
+        phase = time - nearest[0]
+        if lock is None:
+            if abs(phase) >= FRAME_US:
+                continue
+            lock = time
+        phases.append(phase)
+        if time < lock + FADE_US:
+            continue
+        compared += 1
+        if effect == "rainbow":
+            same += hue == nearest[2] and color == nearest[4]
+        else:
+            same += white == nearest[3]
+    return lock, phases, same, compared
+
+
+def main():
+    parser = argparse.ArgumentParser(description = "Checks that lights on the sync wire stay in step.")
+    parser.add_argument("--effect", choices = ["rainbow", "candle"], default = "rainbow")
+    parser.add_argument("--time", type = float, default = 20, help = "simulated seconds")
+    parser.add_argument("--follower", action = "append", help = "power up time in ms and clock error in ppm of a follower, START_MS:CLOCK_PPM")
+    parser.add_argument("--cxx", default = "c++")
+    parser.add_argument("-D", dest = "defines", action = "append", default = [], help = "extra build flags of the firmware")
+    args = parser.parse_args()
+    followers = [tuple(int(x) for x in f.split(":")) for f in (args.follower or FOLLOWERS)]
+    os.makedirs(os.path.join(ROOT, ".bench"), exist_ok = True)
+    leaderExe = build(args.cxx, "LEADER", args.defines)
+    followerExe = build(args.cxx, "FOLLOWER", args.defines)
+    duration = int(args.time * 1e6)
+    beacons = os.path.join(ROOT, ".bench", "sync-beacons.txt")
+    leader = run([leaderExe, duration, beacons, args.effect])
+    with open(beacons) as f:
+        sent = sum(1 for _ in f)
+    print("{}, {:.1f}s simulated, leader sent {} bytes\n".format(args.effect, args.time, sent))
+    print("{:>10} {:>10} {:>8} {:>12} {:>12} {:>6} {:>8}".format("start ms", "clock ppm", "lock ms", "max phase ms", "avg phase ms", "late", "same"))
+    ok = True
+    for start, ppm in followers:
+        follower = run([followerExe, duration, beacons, args.effect, start * 1000, ppm])
+        lock, phases, same, compared = compare(leader, follower, args.effect)
+        if lock is None:
+            print("{:>10} {:>10} {:>8}".format(start, ppm, "-"))
+            ok = False
+            continue
+        late = sum(1 for p in phases if abs(p) >= FRAME_US)
+        worst = max(phases, key = abs)
+        avg = sum(abs(p) for p in phases) / len(phases)
+        print("{:>10} {:>10} {:>8.0f} {:>12.2f} {:>12.2f} {:>6} {:>7.1f}%".format(start, ppm, lock / 1000, worst / 1000, avg / 1000, late,
+            100 * same / compared if compared > 0 else 0))
+        ok = ok and late == 0
+    sys.exit(0 if ok else 1)
+
+
+if __name__ == "__main__":
+    main()
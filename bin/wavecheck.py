@@ -0,0 +1,140 @@
+#!/usr/bin/env python3
+"""Verifies the neopixel waveform of NeopixelStrip::update().
+
+Builds bench/wave.cpp for every supported clock, runs it in the AVRxt simulator (bin/avrsim.py) and records the transitions of RGB_CONTROL_PIN (PB0). The pulses are decoded back to bytes, which must match the sent pattern, and their timings are checked against the WS2812B datasheet:
+
+    T0H     high time of a 0 bit        250 - 550ns
+    T1H     high time of a 1 bit        650 - 950ns
+    TLL     low time between bits       300ns - 5us (many WS2812 parts latch the data after ~6us, well before the 50us of the datasheet)
+
+Both waves, the one sent from the buffer and the one dimmed by the bit loop, are checked against the above with the build's defaults, nothing in bench/wave.cpp relaxes them.
+
+For every configuration the measured minimum and maximum of each time are printed together with the margin to the limits, i.e. how far the worst pulse is from violating the spec. The script fails if any pulse is out of the spec or the data is wrong.
+
+The configurations are the clocks the driver supports, each built for the clock it runs at. The 8MHz build clocked at 10MHz, which the note in neopixel.h describes, is not checked, as its 0 bits are high for only 200ns, below T0H by construction.
+
+Usage: wavecheck.py [--cc avr-g++]
+"""
+
+import argparse
+import os
+import sys
+
+sys.path.insert(0, os.path.dirname(os.path.abspath(__file__)))
+import avrsim
+import bench
+
+# PB0
+PIN_MASK = 0x01
+
+# (name, min ns, max ns)
+SPEC = {
+    "T0H" : (250, 550),
+    "T1H" : (650, 950),
+    "TLL" : (300, 5000),
+}
+
+# bits with high time above are ones, halfway between T0H and T1H
+THRESHOLD = 600
+
+# (F_CPU of the build, actual clock)
+CONFIGS = [
+    (8000000, 8000000),
+    (10000000, 10000000),
+]
+
+# ids of the Wave enum in bench/wave.cpp
+WAVE_BUFFER = 1
+WAVE_DIMMED = 2
+
+
+def pulses(trace, start, end):
+    """Returns the (high, low) cycles of the pulses on the pin between the given cycles. The low time of the last pulse is None."""
+    edges = []
+    level = 0
+    for cycle, out in trace:
+        if cycle < start or cycle > end:
+            continue
+        if (out & PIN_MASK) != level:
+            level = out & PIN_MASK
+            edges.append((cycle, level))
+    if edges and edges[0][1] == 0:
+        raise avrsim.SimError("the pin was high before the update")
+    result = []
+    for i in range(0, len(edges), 2):
+        rise = edges[i][0]
+        fall = edges[i + 1][0] if i + 1 < len(edges) else end
+        low = edges[i + 2][0] - fall if i + 2 < len(edges) else None
+        result.append((fall - rise, low))
+    return result
+
+
+def decode(times):
+    """Decodes the pulses given as (high, low) in ns to bytes, MSB first."""
+    bits = [1 if high > THRESHOLD else 0 for high, low in times]
+    if len(bits) % 8 != 0:
+        raise avrsim.SimError("{} bits sent, not whole bytes".format(len(bits)))
+    return bytes(int("".join(str(b) for b in bits[i:i + 8]), 2) for i in range(0, len(bits), 8))
+
+
+def check(times):
+    """Returns the measured (min, max) in ns of every timing of the spec."""
+    measured = { "T0H" : [], "T1H" : [], "TLL" : [] }
+    for high, low in times:
+        measured["T1H" if high > THRESHOLD else "T0H"].append(high)
+        if low is not None:
+            measured["TLL"].append(low)
+    return { name : (min(values), max(values)) for name, values in measured.items() if values }
+
+
+def run(elf, clock):
+    """Runs the wave firmware, returns the expected and decoded bytes and the pulse timings in ns of every wave."""
+    sim = avrsim.Sim(avrsim.load_elf(elf))
+    markers = {}
+    sim.onStart = lambda id: markers.__setitem__(id, [sim.cycles, None])
+    sim.onEnd = lambda id: markers[id].__setitem__(1, sim.cycles)
+    status = sim.run()
+    if status != 0:
+        raise avrsim.SimError("wave firmware exited with {}".format(status))
+    symbols = avrsim.load_symbols(elf)
+    address = symbols["pattern"] & 0xffff
+    pattern = bytes(sim.read(address + i) for i in range(12))
+    dimmed = bytes((b * 129) >> 8 for b in pattern)
+    ns = 1e9 / clock
+    result = []
+    for id, expected in ((WAVE_BUFFER, pattern), (WAVE_DIMMED, dimmed)):
+        start, end = markers[id]
+        times = [(high * ns, None if low is None else low * ns) for high, low in pulses(sim.ports["B"].trace, start, end)]
+        result.append((id, expected, decode(times), check(times)))
+    return result
+
+
+def main():
+    parser = argparse.ArgumentParser(description = "Verifies the neopixel waveform in the AVRxt simulator.")
+    parser.add_argument("--cc", default = "avr-g++")
+    args = parser.parse_args()
+    os.makedirs(os.path.join(bench.ROOT, ".bench"), exist_ok = True)
+    failed = False
+    for fcpu, clock in CONFIGS:
+        elf = os.path.join(bench.ROOT, ".bench", "wave-{}.elf".format(fcpu))
+        bench.build(args.cc, "wave.cpp", elf, fcpu)
+        try:
+            waves = run(elf, clock)
+        except avrsim.SimError as e:
+            sys.exit("wavecheck: {}".format(e))
+        print("F_CPU {}MHz at {}MHz".format(fcpu / 1e6, clock / 1e6))
+        for id, expected, decoded, timings in waves:
+            ok = decoded == expected
+            failed = failed or not ok
+            print("  wave {}: data {}".format(id, "ok" if ok else "WRONG, sent {} expected {}".format(decoded.hex(), expected.hex())))
+            for name, (lo, hi) in timings.items():
+                smin, smax = SPEC[name]
+                margin = min(lo - smin, smax - hi)
+                failed = failed or margin < 0
+                print("    {}  {:7.0f} - {:7.0f}ns   margin {:6.0f}ns{}".format(name, lo, hi, margin, "  OUT OF SPEC" if margin < 0 else ""))
+    if failed:
+        sys.exit("wavecheck: the waveform does not meet the spec")
+
+
+if __name__ == "__main__":
+    main()
@@ -9,16 +9,56 @@
 
 #include "utils/color.h"
 
-template<uint16_t SIZE>
+/** Largest reordered or RGBW frame in bytes, which is encoded on the stack before it is sent, see NeopixelStrip.
+ */
+#ifndef NEOPIXEL_ENCODE_LIMIT
+#define NEOPIXEL_ENCODE_LIMIT 256
+#endif
+
+/** Order in which the neopixels expect the color channels on the wire. 
+ */
+enum class ColorOrder : uint8_t {
+    GRB, // WS2812, SK6812
+    RGB,
+    BRG,
+    RBG,
+    GBR,
+    BGR,
+};
+
+/** Neopixel strip. 
+ 
+    ORDER is the channel order of the neopixels and RGBW selects 4 channel neopixels (SK6812 RGBW), whose white channel is lit by the part common to all three colors. The global brightness is applied when the pixels are sent, so the drawn colors stay intact and dimming needs no pass over the strip. 
+
+    A current limit can be set, in which case the brightness of each frame is lowered as needed for the estimated current of the strip to fit it. The estimate comes from the channel sum the strip keeps as the pixels change, so it costs a single division per frame. It is conservative for RGBW neopixels, whose white channel replaces three colors. 
+
+    If given a power pin, which switches the rail of the neopixels and is on when low (a P-channel MOSFET, as on the light), the strip powers the neopixels only while they have something to show, as even black neopixels draw ~1mA each. When the frame has been black for the hold-off, given in updates, the rail is cut, and the next frame that is not black powers it up and is sent in the following update, once the neopixels have settled. Blackness is taken from the channel sum, so this costs no pass over the strip either. The hold-off and the settling are counted in updates, so update() must then be called regularly (e.g. every tick) even when nothing is drawn. 
+
+    The bit loop scales each byte by the brightness while the previous one is sent, so dimmed frames go out straight from the buffer, without gaps between the pixels (many WS2812 parts latch after only ~6us of low, well before the 50us of the datasheet). Color stores its channels in the GRB wire order, so GRB strips are always sent straight from the buffer. Reordered and RGBW frames are encoded into a buffer on the stack before the interrupts are disabled and sent from there in one go, which limits them to NEOPIXEL_ENCODE_LIMIT bytes. 
+ */
+template<uint16_t SIZE, ColorOrder ORDER = ColorOrder::GRB, bool RGBW = false>
 class NeopixelStrip : public ColorStrip<SIZE> {
-    using ColorStrip<SIZE>::colors_;
-    using ColorStrip<SIZE>::changed_;
 public:
 
-    NeopixelStrip(gpio::Pin pin):
-        pin_{pin},
-        port_{portOutputRegister(digitalPinToPort(pin_))} {
+    static constexpr uint8_t BYTES_PER_PIXEL = RGBW ? 4 : 3;
+
+    /** Current of a neopixel's channel at full, and of an idle neopixel, in uA (WS2812B).
+     */
+    static constexpr uint32_t CHANNEL_CURRENT = 20000;
+    static constexpr uint32_t QUIESCENT_CURRENT = 1000;
+
+    /** Creates the strip on given data pin, with an optional power pin whose rail is cut after the strip was black for holdOff updates (at least 1). The rail starts off.
+     */
+    NeopixelStrip(gpio::Pin pin, gpio::Pin powerPin = gpio::UNUSED, uint8_t holdOff = 100):
+        pin_{static_cast<uint8_t>(pin)},
+        port_{portOutputRegister(digitalPinToPort(pin_))},
+        powerPin_{powerPin},
+        holdOff_{holdOff} {
         pinMode(pin,OUTPUT);
+        if (powerPin_ != gpio::UNUSED) {
+            pinMode(powerPin_, OUTPUT);
+            digitalWrite(powerPin_, HIGH); // off
+        }
     }
 
     /** Updates the neopixels. 
@@ -27,199 +67,369 @@ public:
      */
     void update() {
         // don't do anything if we don't need to
-        if (!changed_)
+        Color const * frame = ColorStrip<SIZE>::takeFrame();
+        if (powerPin_ != gpio::UNUSED) {
+            if (frame != nullptr)
+                black_ = ColorStrip<SIZE>::channelSum() == 0;
+            frame = gate(frame);
+        }
+        if (frame == nullptr)
             return;
+        scale_ = budget_ == 0 ? brightness_ : limit(brightness_, ColorStrip<SIZE>::channelSum());
+        transmit(frame);
+    }
+
+    uint8_t brightness() const {
+        return brightness_;
+    }
+
+    /** Sets the global brightness, applied when the pixels are sent. Takes effect with the next update, which can be forced by markAsChanged().
+     */
+    void setBrightness(uint8_t value) {
+        brightness_ = value;
+    }
+
+    /** Sets the current the strip may draw in mA, 0 for no limit. Takes effect with the next update, which can be forced by markAsChanged().
+     */
+    void setCurrentLimit(uint16_t mA) {
+        // the channel sum times the brightness + 1 that fits the limit, less the quiescent current
+        uint32_t quiescent = SIZE * QUIESCENT_CURRENT;
+        uint32_t limit = static_cast<uint32_t>(mA) * 1000;
+        if (mA == 0)
+            budget_ = 0;
+        else if (limit <= quiescent)
+            budget_ = 1;
+        else
+            // in two parts so that the product does not overflow
+            budget_ = (limit - quiescent) / CHANNEL_CURRENT * 255 * 256 + (limit - quiescent) % CHANNEL_CURRENT * 255 * 256 / CHANNEL_CURRENT;
+    }
+
+    /** The brightness the last frame was sent with, below brightness() if the current limit lowered it.
+     */
+    uint8_t appliedBrightness() const {
+        return scale_;
+    }
+
+    /** Cuts the rail of the neopixels right away, e.g. before the CPU sleeps. Unless the strip is black, the next update powers the neopixels up again and the frame is resent.
+     */
+    void powerDown() {
+        if (powerPin_ == gpio::UNUSED)
+            return;
+        digitalWrite(powerPin_, HIGH); // off
+        rail_ = Rail::Off;
+    }
+
+    /** Returns true if the neopixels are powered, always true without a power pin.
+     */
+    bool powered() const {
+        return powerPin_ == gpio::UNUSED || rail_ != Rail::Off;
+    }
+    
+private:
+
+    enum class Rail : uint8_t {
+        Off,
+        // powered up in the last update, the frame is sent in the next one
+        Settling,
+        On,
+    };
+
+    /** Advances the power rail for the frame taken by this update (nullptr if none), returns the frame to send, if any.
+     */
+    Color const * gate(Color const * frame) {
+        switch (rail_) {
+            case Rail::Off:
+                if (! black_) {
+                    digitalWrite(powerPin_, LOW); // on
+                    rail_ = Rail::Settling;
+                }
+                return nullptr;
+            case Rail::Settling:
+                rail_ = Rail::On;
+                countdown_ = holdOff_;
+                // whatever was sent while the neopixels were off is lost
+                return frame != nullptr ? frame : ColorStrip<SIZE>::lastFrame();
+            default:
+                if (! black_) {
+                    countdown_ = holdOff_;
+                } else if (--countdown_ == 0) {
+                    digitalWrite(powerPin_, HIGH); // off
+                    rail_ = Rail::Off;
+                }
+                return frame;
+        }
+    }
+
+    /** Returns the highest brightness up to the given one at which a frame with the channel sum fits the current limit.
+     */
+    uint8_t limit(uint8_t brightness, uint32_t sum) const {
+        if (sum * (brightness + 1) <= budget_)
+            return brightness;
+        uint32_t scale = budget_ / sum;
+        return scale == 0 ? 0 : static_cast<uint8_t>(scale - 1);
+    }
+
+    /** Sends a frame from memory, straight from the buffer if it already is in the wire order. Reordered and RGBW frames are encoded into a buffer on the stack first, so that they too are sent without gaps. Either way the bit loop applies the brightness.
+     */
+    void transmit(Color const * frame) {
+        if constexpr (ORDER == ColorOrder::GRB && ! RGBW) {
+            cli();
+            send(reinterpret_cast<uint8_t const *>(frame), SIZE * 3, scale_);
+            sei();
+        } else {
+            static_assert(SIZE * BYTES_PER_PIXEL <= NEOPIXEL_ENCODE_LIMIT, "Reordered and RGBW frames are encoded on the stack before they are sent, raise NEOPIXEL_ENCODE_LIMIT if the stack can take the frame");
+            uint8_t wire[SIZE * BYTES_PER_PIXEL];
+            for (uint16_t i = 0; i < SIZE; ++i)
+                encode(frame[i], wire + i * BYTES_PER_PIXEL);
+            cli();
+            send(wire, sizeof(wire), scale_);
+            sei();
+        }
+    }
+
+    /** Converts the color to the wire order of the neopixels, the brightness is applied by send().
+     */
+    void encode(Color const & color, uint8_t * pixel) const {
+        uint8_t r = color.r;
+        uint8_t g = color.g;
+        uint8_t b = color.b;
+        if (RGBW) {
+            uint8_t w = r < g ? r : g;
+            if (b < w)
+                w = b;
+            r -= w;
+            g -= w;
+            b -= w;
+            pixel[3] = w;
+        }
+        switch (ORDER) {
+            case ColorOrder::GRB: pixel[0] = g; pixel[1] = r; pixel[2] = b; break;
+            case ColorOrder::RGB: pixel[0] = r; pixel[1] = g; pixel[2] = b; break;
+            case ColorOrder::BRG: pixel[0] = b; pixel[1] = r; pixel[2] = g; break;
+            case ColorOrder::RBG: pixel[0] = r; pixel[1] = b; pixel[2] = g; break;
+            case ColorOrder::GBR: pixel[0] = g; pixel[1] = b; pixel[2] = r; break;
+            case ColorOrder::BGR: pixel[0] = b; pixel[1] = g; pixel[2] = r; break;
+        }
+    }
+
+    /** Sends the bytes to the neopixels, each scaled by (scale + 1) / 256 on the way, i.e. unchanged at 255. Must be called with interrupts disabled. 
+
+        The pin is driven through the OUTSET and OUTCLR registers of its port, which unlike writing the whole port needs no precomputed levels and leaves the other pins alone. The cycles this frees in the bit loop load and scale the next byte while the current one is sent, so that dimming costs no pass over the frame and there are no gaps between the bytes. bin/wavecheck.py checks the timing. 
+     
+        The asm uses numeric local labels since it is instantiated for every strip and call site. 
+     */
+    void send(uint8_t const * data, uint16_t count, uint8_t scale) {
 #if (defined ARCH_AVR_MEGATINY)
-        uint8_t pinMask = digitalPinToBitMask(pin_);
-        volatile uint16_t
-            i   = SIZE * 3; // Loop counter
-        volatile uint8_t
-           *ptr = reinterpret_cast<uint8_t*>(colors_),   // Pointer to next byte
-            b   = *ptr++,   // Current byte value
-            hi,             // PORT w/output bit set high
-            lo;             // PORT w/output bit set low
-        cli();
+        uint8_t mask = digitalPinToBitMask(pin_);
+        uint8_t const * ptr = data + 1;
+        // the first byte, the loop scales each next byte while sending the current one
+        uint8_t b = (data[0] * (scale + 1)) >> 8;
+        uint8_t next;
+        uint8_t zero = 0;
         // 8 MHz(ish) AVRxt ---------------------------------------------------------
         #if (F_CPU >= 7400000UL) && (F_CPU <= 9500000UL)
 
-            volatile uint8_t n1, n2 = 0;  // First, next bits out
-
-            // We need to be able to write to the port register in one clock
-            // to meet timing constraints here.
-
             // 10 instruction clocks per bit: HHxxxxxLLL
-            // OUT instructions:              ^ ^    ^   (T=0,2,7)
-
-            hi   = *port_ |  pinMask;
-            lo   = *port_ & ~pinMask;
-            n1 = lo;
-            if (b & 0x80) n1 = hi;
+            // ST instructions:               ^ ^    ^   (T=0,2,7), OUTSET at 0, OUTCLR at 2 for 0 bits and at 7
 
             // Dirty trick: RJMPs proceeding to the next instruction are used
             // to delay two clock cycles in one instruction word (rather than
-            // using two NOPs).  This was necessary in order to squeeze the
-            // loop down to exactly 64 words -- the maximum possible for a
+            // using two NOPs), so that the loop fits the 64 words of a
             // relative branch.
 
             asm volatile(
-            "headD:"                   "\n\t" // Clk  Pseudocode
+            "1:"                                "\n\t" // Clk  Pseudocode
             // Bit 7:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi
-            "mov  %[n2]   , %[lo]"    "\n\t" // 1    n2   = lo
-            "st   %a[port], %[n1]"    "\n\t" // 1    PORT = n1
-            "rjmp .+0"                "\n\t" // 2    nop nop
-            "sbrc %[byte] , 6"        "\n\t" // 1-2  if (b & 0x40)
-            "mov %[n2]   , %[hi]"    "\n\t" // 0-1   n2 = hi
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo
-            "rjmp .+0"                "\n\t" // 2    nop nop
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "sbrs %[byte], 7"                   "\n\t" // 1-2  if (! (b & 0x80))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "ld   %[next], %a[ptr]+"            "\n\t" // 2    next = *ptr++
+            "mul  %[next], %[scale]"            "\n\t" // 2    r1:r0 = next * scale
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "add  r0, %[next]"                  "\n\t" // 1    r1:r0 += next
+            "adc  r1, %[zero]"                  "\n\t" // 1
             // Bit 6:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi
-            "mov  %[n1]   , %[lo]"    "\n\t" // 1    n1   = lo
-            "st   %a[port], %[n2]"    "\n\t" // 1    PORT = n2
-            "rjmp .+0"                "\n\t" // 2    nop nop
-            "sbrc %[byte] , 5"        "\n\t" // 1-2  if (b & 0x20)
-            "mov %[n1]   , %[hi]"    "\n\t" // 0-1   n1 = hi
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo
-            "rjmp .+0"                "\n\t" // 2    nop nop
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "sbrs %[byte], 6"                   "\n\t" // 1-2  if (! (b & 0x40))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
             // Bit 5:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi
-            "mov  %[n2]   , %[lo]"    "\n\t" // 1    n2   = lo
-            "st   %a[port], %[n1]"    "\n\t" // 1    PORT = n1
-            "rjmp .+0"                "\n\t" // 2    nop nop
-            "sbrc %[byte] , 4"        "\n\t" // 1-2  if (b & 0x10)
-            "mov %[n2]   , %[hi]"    "\n\t" // 0-1   n2 = hi
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo
-            "rjmp .+0"                "\n\t" // 2    nop nop
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "sbrs %[byte], 5"                   "\n\t" // 1-2  if (! (b & 0x20))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
             // Bit 4:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi
-            "mov  %[n1]   , %[lo]"    "\n\t" // 1    n1   = lo
-            "st   %a[port], %[n2]"    "\n\t" // 1    PORT = n2
-            "rjmp .+0"                "\n\t" // 2    nop nop
-            "sbrc %[byte] , 3"        "\n\t" // 1-2  if (b & 0x08)
-            "mov %[n1]   , %[hi]"    "\n\t" // 0-1   n1 = hi
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo
-            "rjmp .+0"                "\n\t" // 2    nop nop
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "sbrs %[byte], 4"                   "\n\t" // 1-2  if (! (b & 0x10))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
             // Bit 3:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi
-            "mov  %[n2]   , %[lo]"    "\n\t" // 1    n2   = lo
-            "st   %a[port], %[n1]"    "\n\t" // 1    PORT = n1
-            "rjmp .+0"                "\n\t" // 2    nop nop
-            "sbrc %[byte] , 2"        "\n\t" // 1-2  if (b & 0x04)
-            "mov %[n2]   , %[hi]"    "\n\t" // 0-1   n2 = hi
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo
-            "rjmp .+0"                "\n\t" // 2    nop nop
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "sbrs %[byte], 3"                   "\n\t" // 1-2  if (! (b & 0x08))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
             // Bit 2:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi
-            "mov  %[n1]   , %[lo]"    "\n\t" // 1    n1   = lo
-            "st   %a[port], %[n2]"    "\n\t" // 1    PORT = n2
-            "rjmp .+0"                "\n\t" // 2    nop nop
-            "sbrc %[byte] , 1"        "\n\t" // 1-2  if (b & 0x02)
-            "mov %[n1]   , %[hi]"    "\n\t" // 0-1   n1 = hi
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo
-            "rjmp .+0"                "\n\t" // 2    nop nop
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "sbrs %[byte], 2"                   "\n\t" // 1-2  if (! (b & 0x04))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
             // Bit 1:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi
-            "mov  %[n2]   , %[lo]"    "\n\t" // 1    n2   = lo
-            "st   %a[port], %[n1]"    "\n\t" // 1    PORT = n1
-            "rjmp .+0"                "\n\t" // 2    nop nop
-            "sbrc %[byte] , 0"        "\n\t" // 1-2  if (b & 0x01)
-            "mov %[n2]   , %[hi]"    "\n\t" // 0-1   n2 = hi
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo
-            "sbiw %[count], 1"        "\n\t" // 2    i-- (don't act on Z flag yet)
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "sbrs %[byte], 1"                   "\n\t" // 1-2  if (! (b & 0x02))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "rjmp .+0"                          "\n\t" // 2    nop nop
             // Bit 0:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi
-            "mov  %[n1]   , %[lo]"    "\n\t" // 1    n1   = lo
-            "st   %a[port], %[n2]"    "\n\t" // 1    PORT = n2
-            "ld   %[byte] , %a[ptr]+" "\n\t" // 2    b = *ptr++
-            "sbrc %[byte] , 7"        "\n\t" // 1-2  if (b & 0x80)
-            "mov %[n1]   , %[hi]"    "\n\t" // 0-1   n1 = hi
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo
-            "brne headD"              "\n"   // 2    while(i) (Z flag set above)
-            : [ptr]   "+e" (ptr),
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "sbrs %[byte], 0"                   "\n\t" // 1-2  if (! (b & 0x01))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "mov  %[byte], r1"                  "\n\t" // 1    b = r1
+            "clr  r1"                           "\n\t" // 1
+            "sbiw %[count], 1"                  "\n\t" // 2    i--
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "brne 1b"                           "\n\t" // 2    while (i)
+            : [ptr]   "+x" (ptr),
             [byte]  "+r" (b),
-            [n1]    "+r" (n1),
-            [n2]    "+r" (n2),
-            [count] "+w" (i)
-            : [port]   "e" (port_),
-            [hi]     "r" (hi),
-            [lo]     "r" (lo));
+            [next]  "=&r" (next),
+            [count] "+w" (count)
+            : [port]  "b" (port_),
+            [mask]  "r" (mask),
+            [scale] "r" (scale),
+            [zero]  "r" (zero)
+            : "r0");
 
         #elif (F_CPU >= 9500000UL) && (F_CPU <= 11100000UL)
-            /*
-            volatile uint8_t n1, n2 = 0;  // First, next bits out
-
-            */
-            // 14 instruction clocks per bit: HHHHxxxxLLLLL
-            // ST instructions:               ^   ^   ^   (T=0,4,7)
-            volatile uint8_t next;
-
-            hi   = *port_ |  pinMask;
-            lo   = *port_ & ~pinMask;
-            next = lo;
-            if (b & 0x80) {
-            next = hi;
-            }
-
-            // Don't "optimize" the OUT calls into the bitTime subroutine;
-            // we're exploiting the RCALL and RET as 3- and 4-cycle NOPs!
+
+            // 12 instruction clocks per bit, 13 for the last one: HHHHxxxxLLLL
+            // ST instructions:                                   ^   ^   ^   (T=0,4,8), OUTSET at 0, OUTCLR at 4 for 0 bits and at 8
+
+            // The LPMs are 3 cycle NOPs in one instruction word, what they
+            // read is thrown away.
+            uint8_t junk;
+
             asm volatile(
-            "headD:"                   "\n\t" //        (T =  0)
-            "st   %a[port], %[hi]"    "\n\t" //        (T =  1)
-            "rcall bitTimeD"          "\n\t" // Bit 7  (T = 14)
-            "st   %a[port], %[hi]"    "\n\t"
-            "rcall bitTimeD"          "\n\t" // Bit 6
-            "st   %a[port], %[hi]"    "\n\t"
-            "rcall bitTimeD"          "\n\t" // Bit 5
-            "st   %a[port], %[hi]"    "\n\t"
-            "rcall bitTimeD"          "\n\t" // Bit 4
-            "st   %a[port], %[hi]"    "\n\t"
-            "rcall bitTimeD"          "\n\t" // Bit 3
-            "st   %a[port], %[hi]"    "\n\t"
-            "rcall bitTimeD"          "\n\t" // Bit 2
-            "st   %a[port], %[hi]"    "\n\t"
-            "rcall bitTimeD"          "\n\t" // Bit 1
+            "1:"                                "\n\t" // Clk  Pseudocode
+            // Bit 7:
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "ld   %[next], %a[ptr]+"            "\n\t" // 2    next = *ptr++
+            "sbrs %[byte], 7"                   "\n\t" // 1-2  if (! (b & 0x80))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            // Bit 6:
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "mul  %[next], %[scale]"            "\n\t" // 2    r1:r0 = next * scale
+            "sbrs %[byte], 6"                   "\n\t" // 1-2  if (! (b & 0x40))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            // Bit 5:
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "add  r0, %[next]"                  "\n\t" // 1    r1:r0 += next
+            "adc  r1, %[zero]"                  "\n\t" // 1
+            "sbrs %[byte], 5"                   "\n\t" // 1-2  if (! (b & 0x20))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            // Bit 4:
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "sbrs %[byte], 4"                   "\n\t" // 1-2  if (! (b & 0x10))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            // Bit 3:
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "sbrs %[byte], 3"                   "\n\t" // 1-2  if (! (b & 0x08))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            // Bit 2:
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "sbrs %[byte], 2"                   "\n\t" // 1-2  if (! (b & 0x04))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            // Bit 1:
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "sbrs %[byte], 1"                   "\n\t" // 1-2  if (! (b & 0x02))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "lpm  %[junk], Z"                   "\n\t" // 3    nop nop nop
             // Bit 0:
-            "st   %a[port], %[hi]"    "\n\t" // 1    PORT = hi    (T =  1)
-            "rjmp .+0"                "\n\t" // 2    nop nop      (T =  3)
-            "ld   %[byte] , %a[ptr]+" "\n\t" // 2    b = *ptr++   (T =  5)
-            "st   %a[port], %[next]"  "\n\t" // 1    PORT = next  (T =  6)
-            "mov  %[next] , %[lo]"    "\n\t" // 1    next = lo    (T =  7)
-            "sbrc %[byte] , 7"        "\n\t" // 1-2  if (b & 0x80) (T =  8)
-            "mov %[next] , %[hi]"    "\n\t" // 0-1    next = hi  (T =  9)
-            "st   %a[port], %[lo]"    "\n\t" // 1    PORT = lo    (T = 10)
-            "sbiw %[count], 1"        "\n\t" // 2    i--          (T = 12)
-            "brne headD"              "\n\t" // 2    if (i != 0) -> (next byte) (T = 14)
-            "rjmp doneD"             "\n\t"
-            "bitTimeD:"               "\n\t" //      nop nop nop     (T =  4)
-            "st   %a[port], %[next]" "\n\t" // 1    PORT = next     (T =  5)
-            "mov  %[next], %[lo]"    "\n\t" // 1    next = lo       (T =  6)
-            "rol  %[byte]"           "\n\t" // 1    b <<= 1         (T =  7)
-            "sbrc %[byte], 7"        "\n\t" // 1-2  if (b & 0x80)    (T =  8)
-                "mov %[next], %[hi]"    "\n\t" // 0-1   next = hi      (T =  9)
-            "st   %a[port], %[lo]"   "\n\t" // 1    PORT = lo       (T = 10)
-            "ret"                    "\n\t" // 4    nop nop nop nop (T = 14)
-            "doneD:"                 "\n"
-            : [ptr]   "+e" (ptr),
+            "std  %a[port]+1, %[mask]"          "\n\t" // 1    OUTSET = mask
+            "rjmp .+0"                          "\n\t" // 2    nop nop
+            "sbrs %[byte], 0"                   "\n\t" // 1-2  if (! (b & 0x01))
+            "std  %a[port]+2, %[mask]"          "\n\t" // 0-1   OUTCLR = mask, 0 bit ends
+            "mov  %[byte], r1"                  "\n\t" // 1    b = r1
+            "clr  r1"                           "\n\t" // 1
+            "nop"                               "\n\t" // 1
+            "std  %a[port]+2, %[mask]"          "\n\t" // 1    OUTCLR = mask, 1 bit ends
+            "sbiw %[count], 1"                  "\n\t" // 2    i--
+            "brne 1b"                           "\n\t" // 2    while (i)
+            : [ptr]   "+x" (ptr),
             [byte]  "+r" (b),
-            [next]  "+r" (next),
-            [count] "+w" (i)
-            : [port]   "e" (port_),
-            [hi]     "r" (hi),
-            [lo]     "r" (lo));
+            [next]  "=&r" (next),
+            [junk]  "=&r" (junk),
+            [count] "+w" (count)
+            : [port]  "b" (port_),
+            [mask]  "r" (mask),
+            [scale] "r" (scale),
+            [zero]  "r" (zero)
+            : "r0");
         #else
-            #error "AVR Frequency not supported!
+            #error "AVR Frequency not supported!"
         #endif
 
+        #elif (defined ARCH_MOCK)
+            // the energy model is the only one looking
+            energy::neopixelSend(data, count, scale);
         #else
                 #error "Platform not supported!"
         #endif
-        sei();
     }
-    
-private:
 
     uint8_t pin_;
     volatile uint8_t * port_;
+    uint8_t brightness_ = 255;
+    // brightness the current frame is sent with
+    uint8_t scale_ = 255;
+    // channel sum times brightness + 1 allowed by the current limit, 0 for none
+    uint32_t budget_ = 0;
+    gpio::Pin powerPin_;
+    uint8_t holdOff_;
+    // updates left till the rail is cut, while black
+    uint8_t countdown_ = 0;
+    Rail rail_ = Rail::Off;
+    // whether the last frame taken was black, as is the strip before the first one
+    bool black_ = true;
 
 }; 
 
@@ -1,8 +1,16 @@
 #pragma once
+#if (defined ARCH_AVR_BAREMETAL)
+#include "baremetal.h"
+#else
 #include <Arduino.h>
 #include <Wire.h>
 #include <SPI.h>
 
+/** Pin interrupts are handled by the Arduino core. 
+ */
+#define GPIO_INTERRUPTS_ISR()
+#endif
+
 #if (defined ARCH_AVR_MEGA) || (defined ARCH_AVR_MEGATINY)
 #include <avr/sleep.h>
 #endif
@@ -27,17 +35,57 @@ namespace std {
 
 class cpu {
 public:
+    /** Sets the clock prescaler for F_CPU and starts the PWM timer. 
+     
+        Only does anything on the bare-metal platform, where it must be called first, the Arduino core does this before setup(). 
+     */
+    static void initialize() {
+#if (defined ARCH_AVR_BAREMETAL)
+    #if (F_CPU == 8000000L) || (F_CPU == 10000000L)
+        _PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, CLKCTRL_PDIV_2X_gc | CLKCTRL_PEN_bm);
+    #elif (F_CPU == 16000000L) || (F_CPU == 20000000L)
+        _PROTECTED_WRITE(CLKCTRL.MCLKCTRLB, 0);
+    #else
+        #error "F_CPU not supported by the bare-metal platform"
+    #endif
+        // split mode, 8bit PWM on WO0-2 at F_CPU / 16 / 255, i.e. ~2kHz at 8MHz
+        TCA0.SPLIT.CTRLD = TCA_SPLIT_SPLITM_bm;
+        TCA0.SPLIT.LPER = 254;
+        TCA0.SPLIT.HPER = 254;
+        TCA0.SPLIT.CTRLA = TCA_SPLIT_CLKSEL_DIV16_gc | TCA_SPLIT_ENABLE_bm;
+#endif
+    }
+
     static void delay_us(unsigned value) {
         delayMicroseconds(value);
     }
 
+    /** Waits the given milliseconds. With megaTinyCore, the CPU idles between the millis timer interrupts, which wake it every millisecond, and busy waits only the last one so that the wait stays exact. The bare-metal platform has no timer to wake it and busy waits. 
+     */
     static void delay_ms(unsigned value) {
+#if (defined ARCH_AVR_MEGATINY) && (! defined ARCH_AVR_BAREMETAL)
+        unsigned long start = micros();
+        unsigned long us = value * 1000ul;
+        set_sleep_mode(SLEEP_MODE_IDLE);
+        while (micros() - start + 1000 < us) {
+            sleep_enable();
+            sleep_cpu();
+            sleep_disable();
+        }
+        while (micros() - start < us) {}
+#else
         delay(value);
+#endif
     }
 
+    /** Powers the CPU down until woken up by an interrupt. 
+     */
     static void sleep() {
 #if (defined ARCH_AVR_MEGATINY)
+        set_sleep_mode(SLEEP_MODE_PWR_DOWN);
+        sleep_enable();
         sleep_cpu();
+        sleep_disable();
 #endif
     }
 
@@ -64,6 +112,58 @@ public:
 }; // wdt
 
 
+/** EEPROM access. 
+ 
+    On megaTinyCore the EEPROM is read directly from the data space and written through the NVM controller page buffer. Writes do not wait for the erase & write to complete, only the next access does, so the CPU can keep running during the few milliseconds the write takes. Other platforms do not persist anything. 
+ */
+class eeprom {
+public:
+
+    static uint8_t read(uint16_t address) {
+#if (defined ARCH_AVR_MEGATINY)
+        wait();
+        return *reinterpret_cast<uint8_t volatile *>(MAPPED_EEPROM_START + address);
+#else
+        return 0xff;
+#endif
+    }
+
+    static void read(uint16_t address, uint8_t * buffer, uint8_t size) {
+        while (size-- > 0)
+            *(buffer++) = read(address++);
+    }
+
+    /** Writes the given bytes, issuing one erase & write per EEPROM page touched. 
+     */
+    static void write(uint16_t address, uint8_t const * buffer, uint8_t size) {
+#if (defined ARCH_AVR_MEGATINY)
+        while (size > 0) {
+            wait();
+            // writing to the mapped EEPROM loads the page buffer
+            do {
+                *reinterpret_cast<uint8_t volatile *>(MAPPED_EEPROM_START + address) = *(buffer++);
+                ++address;
+                --size;
+            } while (size > 0 && (address % EEPROM_PAGE_SIZE) != 0);
+            _PROTECTED_WRITE_SPM(NVMCTRL.CTRLA, NVMCTRL_CMD_PAGEERASEWRITE_gc);
+        }
+#else
+        (void)address;
+        (void)buffer;
+        (void)size;
+#endif
+    }
+
+    /** Waits for any pending write to finish. 
+     */
+    static void wait() {
+#if (defined ARCH_AVR_MEGATINY)
+        while (NVMCTRL.STATUS & NVMCTRL_EEBUSY_bm);
+#endif
+    }
+
+}; // eeprom
+
 class gpio {
 public:
     using Pin = int;
@@ -123,14 +223,24 @@ public:
 #endif
     }
 
-    static void initializeSlave(uint8_t address) {
+    /** Initializes the TWI in slave mode with the given address. 
+     
+        If alternatePins is true, the TWI is routed to its alternate pins (PA1 SDA, PA2 SCL), which on the ATtiny1604 are the only ones that do not collide with the neopixel control & power pins. 
+     */
+    static void initializeSlave(uint8_t address, bool alternatePins = false) {
 #if (defined ARCH_AVR_MEGATINY)
         cli();
         // turn I2C off in case it was running before
         TWI0.MCTRLA = 0;
         TWI0.SCTRLA = 0;
         // make sure that the pins are nout out - HW issue with the chip, will fail otherwise
-        PORTB.OUTCLR = 0x03; // PB0, PB1
+        if (alternatePins) {
+            PORTMUX.CTRLB |= PORTMUX_TWI0_bm;
+            PORTA.OUTCLR = 0x06; // PA1, PA2
+        } else {
+            PORTMUX.CTRLB &= ~PORTMUX_TWI0_bm;
+            PORTB.OUTCLR = 0x03; // PB0, PB1
+        }
         // set the address and disable general call, disable second address and set no address mask (i.e. only the actual address will be responded to)
         TWI0.SADDR = address << 1;
         TWI0.SADDRMASK = 0;
@@ -299,15 +409,98 @@ private:
 #endif
 }; // i2c
 
+class adc {
+public:
+
+    /** Returns the supply voltage in millivolts. 
+     
+        Measures the internal 1.1V reference against VDD so that no pin is required. Takes a few tens of microseconds, so should be called sparingly. 
+     */
+    static uint16_t readVcc() {
+#if (defined ARCH_AVR_MEGATINY)
+        VREF.CTRLA = (VREF.CTRLA & ~VREF_ADC0REFSEL_gm) | VREF_ADC0REFSEL_1V1_gc;
+        ADC0.CTRLC = ADC_SAMPCAP_bm | ADC_REFSEL_VDDREF_gc | ADC_PRESC_DIV16_gc;
+        // give the reference time to settle before the first sample
+        ADC0.CTRLD = ADC_INITDLY_DLY32_gc;
+        ADC0.MUXPOS = ADC_MUXPOS_INTREF_gc;
+        ADC0.CTRLA = ADC_ENABLE_bm;
+        ADC0.COMMAND = ADC_STCONV_bm;
+        while (! (ADC0.INTFLAGS & ADC_RESRDY_bm));
+        uint16_t result = ADC0.RES;
+        // turn the ADC off so that it does not draw current
+        ADC0.CTRLA = 0;
+        return result == 0 ? 0 : static_cast<uint16_t>(1100UL * 1023 / result);
+#else
+        return 0;
+#endif
+    }
+
+    /** Returns the temperature of the chip in 1/16 K. 
+
+        Measures the internal sensor against the 1.1V reference and applies the factory calibration from the signature row. The sensor needs longer sampling, so the conversion takes ~100 microseconds, call sparingly. 
+     */
+    static uint16_t readTemperature() {
+#if (defined ARCH_AVR_MEGATINY)
+        VREF.CTRLA = (VREF.CTRLA & ~VREF_ADC0REFSEL_gm) | VREF_ADC0REFSEL_1V1_gc;
+        ADC0.CTRLC = ADC_SAMPCAP_bm | ADC_REFSEL_INTREF_gc | ADC_PRESC_DIV16_gc;
+        // at least 32us of both the initial delay and the sampling (2us ADC clock)
+        ADC0.CTRLD = ADC_INITDLY_DLY32_gc;
+        ADC0.SAMPCTRL = 16;
+        ADC0.MUXPOS = ADC_MUXPOS_TEMPSENSE_gc;
+        ADC0.CTRLA = ADC_ENABLE_bm;
+        ADC0.COMMAND = ADC_STCONV_bm;
+        while (! (ADC0.INTFLAGS & ADC_RESRDY_bm));
+        uint16_t result = ADC0.RES;
+        ADC0.CTRLA = 0;
+        ADC0.SAMPCTRL = 0;
+        int8_t offset = static_cast<int8_t>(SIGROW.TEMPSENSE1);
+        uint8_t gain = SIGROW.TEMPSENSE0;
+        return static_cast<uint16_t>((static_cast<uint32_t>(result - offset) * gain) >> 4);
+#else
+        return 0;
+#endif
+    }
+
+    /** Returns the voltage on given pin as a 10 bit reading against VDD, i.e. 1023 at VDD. 
+
+        Like readVcc(), turns the ADC on for the single conversion only. 
+     */
+    static uint16_t read(gpio::Pin pin) {
+#if (defined ARCH_AVR_MEGATINY)
+        ADC0.CTRLC = ADC_SAMPCAP_bm | ADC_REFSEL_VDDREF_gc | ADC_PRESC_DIV16_gc;
+        ADC0.CTRLD = 0;
+        ADC0.MUXPOS = digitalPinToAnalogInput(pin);
+        ADC0.CTRLA = ADC_ENABLE_bm;
+        ADC0.COMMAND = ADC_STCONV_bm;
+        while (! (ADC0.INTFLAGS & ADC_RESRDY_bm));
+        uint16_t result = ADC0.RES;
+        ADC0.CTRLA = 0;
+        return result;
+#else
+        return analogRead(pin);
+#endif
+    }
+
+}; // adc
+
 class spi {
 public:
 
     using Device = gpio::Pin;
 
+    /** Callback invoked from the SPI interrupt when an asynchronous send completes. 
+     */
+    using Callback = void (*)();
+
+    /** Initializes the SPI in master mode. 
+     
+        On megaTinyCore the SPI runs in buffered mode so that the next byte is written to the transmit buffer while the current one is being shifted out and there are no gaps between bytes. 
+     */
     static void initialize() {
 #if (defined ARCH_AVR_MEGATINY)
         SPI0.CTRLA = SPI_MASTER_bm | SPI_ENABLE_bm | SPI_CLK2X_bm;
-        SPI0.CTRLB = SPI_SSD_bm;
+        SPI0.CTRLB = SPI_BUFEN_bm | SPI_SSD_bm;
+        SPI0.INTCTRL = 0;
     #if (defined ARCH_ATTINY_1616) | (defined ARCH_ATTINY_3216)
         gpio::output(16); // SCK
         gpio::input(15); // MISO
@@ -344,30 +537,286 @@ public:
 
     static uint8_t transfer(uint8_t value) {
 #if (defined ARCH_AVR_MEGATINY)
-        // megatinycore says this speeds up by 10% - have to check that this is really the truth
-        //asm volatile("nop");
+        while (! (SPI0.INTFLAGS & SPI_DREIF_bm));
         SPI0.DATA = value;
-        while (! (SPI0.INTFLAGS & SPI_IF_bm));
+        while (! (SPI0.INTFLAGS & SPI_RXCIF_bm));
         return SPI0.DATA;            
 #else
         return SPI.transfer(value);
 #endif
     }
 
+    /** Full duplex transfer. 
+     
+        Keeps two bytes in flight so that the shift register never idles, but never more so that the two byte receive buffer cannot overflow. 
+     */
     static size_t transfer(uint8_t const * tx, uint8_t * rx, size_t numBytes) { 
+#if (defined ARCH_AVR_MEGATINY)
+        size_t sent = 0;
+        size_t received = 0;
+        while (received < numBytes) {
+            uint8_t flags = SPI0.INTFLAGS;
+            if (sent < numBytes && sent - received < 2 && (flags & SPI_DREIF_bm))
+                SPI0.DATA = tx[sent++];
+            if (flags & SPI_RXCIF_bm)
+                rx[received++] = SPI0.DATA;
+        }
+#else
         for (size_t i = 0; i < numBytes; ++i)
             *(rx++) = transfer(*(tx++));
+#endif
         return numBytes;
     }
 
+    /** Sends the given bytes, discarding whatever is received. 
+     
+        Refills the transmit buffer as soon as it is empty, so the bytes are sent back to back at the wire rate. 
+     */
     static void send(uint8_t const * data, size_t numBytes) {
+#if (defined ARCH_AVR_MEGATINY)
+        SPI0.INTFLAGS = SPI_TXCIF_bm;
+        for (size_t i = 0; i < numBytes; ++i) {
+            while (! (SPI0.INTFLAGS & SPI_DREIF_bm));
+            SPI0.DATA = *(data++);
+            // keep the receive buffer from overflowing
+            if (SPI0.INTFLAGS & SPI_RXCIF_bm)
+                SPI0.DATA;
+        }
+        // wait for the last byte to be shifted out and discard what's left in the receive buffer
+        while (! (SPI0.INTFLAGS & SPI_TXCIF_bm));
+        flushReceive();
+#else
         for (size_t i = 0; i < numBytes; ++i)
             transfer(*(data++));
+#endif
     }
 
     static void receive(uint8_t * data, size_t numBytes) {
+#if (defined ARCH_AVR_MEGATINY)
+        size_t sent = 0;
+        size_t received = 0;
+        while (received < numBytes) {
+            uint8_t flags = SPI0.INTFLAGS;
+            if (sent < numBytes && sent - received < 2 && (flags & SPI_DREIF_bm)) {
+                SPI0.DATA = 0;
+                ++sent;
+            }
+            if (flags & SPI_RXCIF_bm)
+                data[received++] = SPI0.DATA;
+        }
+#else
         for (size_t i = 0; i < numBytes; ++i)
             *(data++) = transfer(0);
+#endif
+    }
+
+    /** Sends the given bytes to the device in the background. 
+     
+        Selects the device, feeds the transmit buffer from the SPI interrupt and when the last byte has been shifted out, deselects the device and calls the callback (from the interrupt). The data must stay valid until then and no other transfers may be started, which can be checked with busy(). 
+
+        The interrupt costs a few tens of cycles per byte, so at the highest SPI clocks the synchronous send() is faster. The asynchronous send is for freeing the CPU at lower clocks. 
+     */
+    static void sendAsync(Device device, uint8_t const * data, size_t numBytes, Callback callback = nullptr) {
+        begin(device);
+#if (defined ARCH_AVR_MEGATINY)
+        asyncDevice_ = device;
+        asyncData_ = data;
+        asyncSize_ = numBytes;
+        asyncCallback_ = callback;
+        SPI0.INTFLAGS = SPI_TXCIF_bm;
+        SPI0.INTCTRL = (numBytes > 0) ? SPI_DREIE_bm : SPI_TXCIE_bm;
+#else
+        send(data, numBytes);
+        end(device);
+        if (callback != nullptr)
+            callback();
+#endif
+    }
+
+    /** Returns true if an asynchronous send is in progress. 
+     */
+    static bool busy() {
+#if (defined ARCH_AVR_MEGATINY)
+        return SPI0.INTCTRL != 0;
+#else
+        return false;
+#endif
+    }
+
+#if (defined ARCH_AVR_MEGATINY)
+    /** The SPI interrupt handler. Must be called from SPI0_INT_vect, see SPI_ASYNC_ISR. 
+     */
+    static void interrupt() {
+        if (asyncSize_ > 0) {
+            SPI0.DATA = *(asyncData_++);
+            if (--asyncSize_ == 0) {
+                // the flag may be left over from the shifter running dry between earlier bytes, it must only be set by the last byte
+                SPI0.INTFLAGS = SPI_TXCIF_bm;
+                SPI0.INTCTRL = SPI_TXCIE_bm;
+            }
+            if (SPI0.INTFLAGS & SPI_RXCIF_bm)
+                SPI0.DATA;
+        } else {
+            SPI0.INTCTRL = 0;
+            SPI0.INTFLAGS = SPI_TXCIF_bm;
+            flushReceive();
+            end(asyncDevice_);
+            if (asyncCallback_ != nullptr)
+                asyncCallback_();
+        }
+    }
+#endif
+
+private:
+
+#if (defined ARCH_AVR_MEGATINY)
+    static void flushReceive() {
+        while (SPI0.INTFLAGS & SPI_RXCIF_bm)
+            SPI0.DATA;
+        SPI0.INTFLAGS = SPI_BUFOVF_bm;
+    }
+
+    static inline Device asyncDevice_;
+    static inline uint8_t const * volatile asyncData_;
+    static inline volatile size_t asyncSize_;
+    static inline Callback asyncCallback_;
+#endif
+
+}; // spi
+
+/** Declares the SPI interrupt that drives spi::sendAsync. Must be used in exactly one translation unit that uses asynchronous sends. 
+ */
+#if (defined ARCH_AVR_MEGATINY)
+#define SPI_ASYNC_ISR() ISR(SPI0_INT_vect) { spi::interrupt(); }
+#else
+#define SPI_ASYNC_ISR()
+#endif
+
+class uart {
+public:
+
+    /** Initializes USART0 for 8N1 at the given baudrate with the receive interrupt enabled. 
+     
+        If alternatePins is true, the USART is routed to its alternate pins (PA1 TX, PA2 RX), as the default ones (PB2 TX, PB3 RX) collide with the white PWM. The interrupt handlers are provided by the driver using the USART, see e.g. utils/serial_registers.h. 
+     */
+    static void initialize(uint32_t baudrate, bool alternatePins = false) {
+#if (defined ARCH_AVR_MEGATINY)
+        cli();
+        if (alternatePins) {
+            PORTMUX.CTRLB |= PORTMUX_USART0_bm;
+            PORTA.OUTSET = 0x02; // PA1 idles high
+            PORTA.DIRSET = 0x02;
+        } else {
+            PORTMUX.CTRLB &= ~PORTMUX_USART0_bm;
+            PORTB.OUTSET = 0x04; // PB2 idles high
+            PORTB.DIRSET = 0x04;
+        }
+        // normal speed mode, BAUD is 64 * F_CPU / (16 * baudrate), rounded
+        USART0.BAUD = static_cast<uint16_t>((F_CPU * 4 + baudrate / 2) / baudrate);
+        USART0.CTRLC = USART_CMODE_ASYNCHRONOUS_gc | USART_PMODE_DISABLED_gc | USART_SBMODE_1BIT_gc | USART_CHSIZE_8BIT_gc;
+        USART0.CTRLA = USART_RXCIE_bm;
+        USART0.CTRLB = USART_RXEN_bm | USART_TXEN_bm;
+        sei();
+#else
+        (void)baudrate;
+        (void)alternatePins;
+#endif
+    }
+
+    /** Enables the data register empty interrupt, which then pulls the bytes to send from the driver until it has none and disables itself. 
+     */
+    static void startTransmit() {
+#if (defined ARCH_AVR_MEGATINY)
+        USART0.CTRLA |= USART_DREIE_bm;
+#endif
+    }
+
+}; // uart
+
+/** The wire shared by synchronized lights, on PB3 (pin 4), see utils/sync.h.
+
+    USART0 can only transmit on PB2 (the white PWM) or PA1, but its default receive pin is PB3. So the leader bit-bangs the bytes (8N1 at BAUDRATE) on PB3 with the interrupts disabled, while the followers receive them with the USART, one receive interrupt per byte. Only one light on the wire may be the leader. 
+ */
+class syncwire {
+public:
+
+    static constexpr uint32_t BAUDRATE = 38400;
+
+    static void initializeTransmitter() {
+#if (defined ARCH_AVR_MEGATINY)
+        PORTB.OUTSET = 0x08; // PB3 idles high
+        PORTB.DIRSET = 0x08;
+#endif
+    }
+
+    /** Enables the USART receiver on PB3, without the transmitter so that PB2 stays the white PWM. The receive interrupt handler is provided by the driver, see SYNC_CLOCK_ISR. 
+     */
+    static void initializeReceiver() {
+#if (defined ARCH_AVR_MEGATINY)
+        cli();
+        PORTMUX.CTRLB &= ~PORTMUX_USART0_bm;
+        PORTB.DIRCLR = 0x08;
+        // a follower without the wire connected must not receive noise
+        PORTB.PIN3CTRL |= PORT_PULLUPEN_bm;
+        USART0.BAUD = static_cast<uint16_t>((F_CPU * 4 + BAUDRATE / 2) / BAUDRATE);
+        USART0.CTRLC = USART_CMODE_ASYNCHRONOUS_gc | USART_PMODE_DISABLED_gc | USART_SBMODE_1BIT_gc | USART_CHSIZE_8BIT_gc;
+        USART0.CTRLA = USART_RXCIE_bm;
+        USART0.CTRLB = USART_RXEN_bm;
+        sei();
+#endif
+    }
+
+    /** Sends the bytes, takes 10 bit times per byte with the interrupts disabled, i.e. ~1ms for a sync message, which nothing else on the light may need the interrupts for. 
+     */
+    static void send(uint8_t const * data, uint8_t size) {
+        cli();
+        while (size-- > 0)
+            sendByte(*(data++));
+        sei();
+    }
+
+private:
+
+    /** Sends a byte with a start and a stop bit, LSB first. 
+     
+        Each bit takes exactly BIT_CYCLES so that the timing does not depend on the compiler: 9 cycles of the loop, 3 per iteration of the delay loop and up to 2 nops for the rest. Setting the pin takes 4 cycles either way, the edges of ones and zeros are 2 cycles apart, which does not accumulate. 
+     */
+    static void sendByte(uint8_t value) {
+#if (defined ARCH_AVR_MEGATINY)
+        constexpr uint16_t BIT_CYCLES = (F_CPU + BAUDRATE / 2) / BAUDRATE;
+        constexpr uint8_t DELAY = (BIT_CYCLES - 9) / 3;
+        constexpr uint8_t PAD = (BIT_CYCLES - 9) % 3;
+        static_assert(BIT_CYCLES - 9 < 3 * 256, "Sync wire baudrate too low for the CPU clock");
+        // stop bit, 8 data bits, start bit
+        uint16_t frame = static_cast<uint16_t>(value) << 1 | 0x200;
+        uint8_t bits = 10;
+        uint8_t wait;
+        asm volatile(
+            "1:"                        "\n\t" // Clk
+            "sbrc %A[frame], 0"         "\n\t" // 1-2  if (frame & 1)
+            "sbi  %[port], 3"           "\n\t" // 0-1    PB3 = high
+            "sbrs %A[frame], 0"         "\n\t" // 1-2  if (! (frame & 1))
+            "cbi  %[port], 3"           "\n\t" // 0-1    PB3 = low
+            "lsr  %B[frame]"            "\n\t" // 1    frame >>= 1
+            "ror  %A[frame]"            "\n\t" // 1
+            "ldi  %[wait], %[delay]"    "\n\t" // 1
+            "2:"                        "\n\t"
+            "dec  %[wait]"              "\n\t" // 1    3 * DELAY - 1
+            "brne 2b"                   "\n\t" // 1-2
+            ".rept %[pad]"              "\n\t" // PAD
+            "nop"                       "\n\t"
+            ".endr"                     "\n\t"
+            "dec  %[bits]"              "\n\t" // 1
+            "brne 1b"                   "\n"   // 2
+            : [frame] "+r" (frame),
+              [bits]  "+r" (bits),
+              [wait]  "=&d" (wait)
+            : [port]  "I" (_SFR_IO_ADDR(VPORTB_OUT)),
+              [delay] "M" (DELAY),
+              [pad]   "n" (PAD));
+#else
+        (void)value;
+#endif
     }
 
-}; // spi
\ No newline at end of file
+}; // syncwire
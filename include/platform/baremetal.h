@@ -0,0 +1,194 @@
+#pragma once
+
+/** Bare-metal replacement of the Arduino core for the megaTinyCore parts.
+
+    Implements the subset of the Arduino API the firmware uses directly on the registers, so that the build needs neither the Arduino runtime, nor the Wire and SPI libraries (the platform classes in arduino.h drive the TWI and SPI0 on their own). Compared to the core, there is
+
+    - no millis timer and its interrupt, the firmware keeps time in ticks, delays are busy waits,
+    - no pin tables in flash, the pin mapping of the ATtiny1604 below folds into constants for constant pins, so that digitalWrite is a single instruction,
+    - no Wire & SPI buffers,
+    - a pin interrupt dispatch that only looks at the pins that changed.
+
+    The pins are numbered as in megaTinyCore. PWM is available on PB0, PB1 and PB2 (pins 7, 6, 5) from TCA0 in split mode at ~2kHz, analogWrite on other pins writes the closest digital level.
+
+    The firmware provides its own main(), which must call cpu::initialize() first, and must declare the pin interrupts with GPIO_INTERRUPTS_ISR() in exactly one translation unit.
+
+    The clock prescaler is set for F_CPU from the oscillator selected by the OSCCFG fuse, i.e. 16MHz for 8 and 16MHz and 20MHz for 10 and 20MHz. The build writes no fuses and its upload only writes the flash, so the fuses are the ones megaTinyCore burnt for an Arduino environment of the same F_CPU, e.g. by `pio run -e rcboy-avr -t fuses`, which also sets the 2.7V brown-out of board_hardware.bod. A part whose OSCCFG selects the other oscillator runs the firmware at 5/4 or 4/5 of F_CPU, which breaks the neopixel timing. 
+ */
+
+#if (! defined ARCH_ATTINY_1604)
+    #error "The bare-metal platform only has the pin mapping of the ATtiny1604"
+#endif
+
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <avr/io.h>
+#include <avr/interrupt.h>
+#include <avr/pgmspace.h>
+#include <avr/xmega.h>
+#include <util/delay.h>
+
+#ifndef MAPPED_EEPROM_START
+#define MAPPED_EEPROM_START EEPROM_START
+#endif
+
+#define LOW 0
+#define HIGH 1
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+/** Pin mapping of the ATtiny1604: pins 0-3 and 8-11 are on port A, 4-7 on port B.
+ */
+inline uint8_t digitalPinToPort(uint8_t pin) {
+    return (pin >= 4 && pin <= 7) ? 1 : 0;
+}
+
+inline PORT_t & digitalPinToPortStruct(uint8_t pin) {
+    return digitalPinToPort(pin) == 1 ? PORTB : PORTA;
+}
+
+inline uint8_t digitalPinToBitPosition(uint8_t pin) {
+    // PA4 PA5 PA6 PA7 PB3 PB2 PB1 PB0 PA1 PA2 PA3 PA0
+    constexpr uint8_t bits[] = { 4, 5, 6, 7, 3, 2, 1, 0, 1, 2, 3, 0 };
+    return bits[pin];
+}
+
+inline uint8_t digitalPinToBitMask(uint8_t pin) {
+    return 1 << digitalPinToBitPosition(pin);
+}
+
+/** The ADC input of the pin, which on port A is the bit position (AIN0-7), on port B only PB0 (AIN11) and PB1 (AIN10) have one.
+ */
+inline uint8_t digitalPinToAnalogInput(uint8_t pin) {
+    return digitalPinToPort(pin) == 0 ? digitalPinToBitPosition(pin) : 11 - digitalPinToBitPosition(pin);
+}
+
+inline uint8_t digitalPinToInterrupt(uint8_t pin) {
+    return pin;
+}
+
+inline volatile uint8_t * portOutputRegister(uint8_t port) {
+    return port == 1 ? & PORTB.OUT : & PORTA.OUT;
+}
+
+inline volatile uint8_t & digitalPinToControl(uint8_t pin) {
+    return (& digitalPinToPortStruct(pin).PIN0CTRL)[digitalPinToBitPosition(pin)];
+}
+
+/** Returns the split mode TCA0 compare enable bit of the pin, or 0 if the pin has no PWM.
+ */
+inline uint8_t digitalPinToPwmEnable(uint8_t pin) {
+    switch (pin) {
+        case 7: return TCA_SPLIT_LCMP0EN_bm; // PB0, WO0
+        case 6: return TCA_SPLIT_LCMP1EN_bm; // PB1, WO1
+        case 5: return TCA_SPLIT_LCMP2EN_bm; // PB2, WO2
+        default: return 0;
+    }
+}
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    PORT_t & port = digitalPinToPortStruct(pin);
+    uint8_t mask = digitalPinToBitMask(pin);
+    if (mode == OUTPUT) {
+        port.DIRSET = mask;
+    } else {
+        port.DIRCLR = mask;
+        if (mode == INPUT_PULLUP)
+            digitalPinToControl(pin) |= PORT_PULLUPEN_bm;
+        else
+            digitalPinToControl(pin) &= ~PORT_PULLUPEN_bm;
+    }
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+    // writing the pin stops its PWM
+    if (digitalPinToPwmEnable(pin) != 0)
+        TCA0.SPLIT.CTRLB &= ~digitalPinToPwmEnable(pin);
+    PORT_t & port = digitalPinToPortStruct(pin);
+    if (value)
+        port.OUTSET = digitalPinToBitMask(pin);
+    else
+        port.OUTCLR = digitalPinToBitMask(pin);
+}
+
+inline uint8_t digitalRead(uint8_t pin) {
+    return (digitalPinToPortStruct(pin).IN & digitalPinToBitMask(pin)) ? HIGH : LOW;
+}
+
+inline void analogWrite(uint8_t pin, uint8_t value) {
+    uint8_t enable = digitalPinToPwmEnable(pin);
+    if (enable == 0 || value == 0 || value == 255) {
+        digitalWrite(pin, value >= 128);
+        return;
+    }
+    (& TCA0.SPLIT.LCMP0)[digitalPinToBitPosition(pin) * 2] = value;
+    TCA0.SPLIT.CTRLB |= enable;
+}
+
+/** Random number in [min, max), min for an empty range, like the Arduino core. 
+ */
+inline long random(long min, long max) {
+    if (max <= min)
+        return min;
+    return min + ::random() % (max - min);
+}
+
+inline void delayMicroseconds(unsigned us) {
+    while (us-- > 0)
+        __builtin_avr_delay_cycles(F_CPU / 1000000 - 4);
+}
+
+inline void delay(unsigned long ms) {
+    while (ms-- > 0)
+        _delay_ms(1);
+}
+
+/** Pin change interrupts.
+ */
+class interrupts {
+public:
+
+    using Handler = void (*)();
+
+    /** Calls the handler on the given edges of the pin, which keeps its pullup.
+     */
+    static void attach(uint8_t pin, Handler handler, uint8_t mode) {
+        handlers_[digitalPinToPort(pin)][digitalPinToBitPosition(pin)] = handler;
+        uint8_t sense = mode == CHANGE ? PORT_ISC_BOTHEDGES_gc : mode == RISING ? PORT_ISC_RISING_gc : PORT_ISC_FALLING_gc;
+        volatile uint8_t & ctrl = digitalPinToControl(pin);
+        ctrl = (ctrl & ~PORT_ISC_gm) | sense;
+    }
+
+    /** Clears the interrupt flags of the port and calls the handlers of the pins that changed. Called from the port interrupts, see GPIO_INTERRUPTS_ISR.
+     */
+    static void dispatch(uint8_t port) {
+        PORT_t & p = port == 1 ? PORTB : PORTA;
+        uint8_t flags = p.INTFLAGS;
+        p.INTFLAGS = flags;
+        for (uint8_t i = 0; flags != 0; ++i, flags >>= 1)
+            if ((flags & 1) && handlers_[port][i] != nullptr)
+                handlers_[port][i]();
+    }
+
+private:
+
+    static inline Handler handlers_[2][8];
+
+}; // interrupts
+
+inline void attachInterrupt(uint8_t pin, void (*handler)(), uint8_t mode) {
+    interrupts::attach(pin, handler, mode);
+}
+
+/** Declares the pin interrupts that call the handlers attached by attachInterrupt. Must be used in exactly one translation unit.
+ */
+#define GPIO_INTERRUPTS_ISR() \
+    ISR(PORTA_PORT_vect) { interrupts::dispatch(0); } \
+    ISR(PORTB_PORT_vect) { interrupts::dispatch(1); }
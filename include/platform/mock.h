@@ -0,0 +1,674 @@
+#pragma once
+#include <stdint.h>
+#include <stdlib.h>
+#include <string.h>
+#include <vector>
+
+/** Host mock of the Arduino platform.
+
+    Runs the firmware on the host in simulated time. The pins are plain state, their input levels are driven by the host program, which schedules the changes (e.g. button presses) on the board's timeline. Time passes only in delays and in sleep, the code in between takes no time, which for the light, whose loop is dominated by the 10ms delay, is off by a few percent at most. The error of the CPU clock can be set, so that several simulated lights drift apart like real ones.
+
+    The sync wire of the board records the bytes it sends, and the host can schedule bytes to be received, so that several lights (one per process) can be run off the beacons of a leader, see bench/sync.cpp. Likewise the host can schedule writes of an I2C master, which are handed to the bus event handlers of the I2C slave (see I2CRegisters) and wake the CPU up like the TWI address match does, see bench/resume.cpp.
+
+    The energy model integrates the current drawn by the CPU and by the loads attached to the pins over the simulated time, see the energy class below.
+ */
+
+#define LOW 0
+#define HIGH 1
+
+#define INPUT 0
+#define OUTPUT 1
+#define INPUT_PULLUP 2
+
+#define CHANGE 1
+#define FALLING 2
+#define RISING 3
+
+#define PROGMEM
+
+inline uint8_t pgm_read_byte(void const * address) {
+    return *static_cast<uint8_t const *>(address);
+}
+
+inline void cli() {}
+inline void sei() {}
+
+/** The pin interrupts only wake the board up, see board::sleep().
+ */
+#define GPIO_INTERRUPTS_ISR()
+
+/** The simulated board, i.e. its pins and time.
+ */
+class board {
+public:
+
+    static constexpr uint8_t PINS = 12;
+
+    enum class CpuState : uint8_t {
+        Active,
+        Idle,
+        Sleep,
+    };
+
+    /** Thrown when the CPU sleeps and no more wakeups are scheduled, i.e. the simulation is over.
+     */
+    struct Finished {};
+
+    /** Current simulated time in microseconds.
+     */
+    static uint64_t now() {
+        return now_;
+    }
+
+    /** Schedules a change of the input level of given pin at the given time.
+     */
+    static void schedule(uint64_t time, uint8_t pin, bool level) {
+        auto i = events_.begin();
+        while (i != events_.end() && i->time <= time)
+            ++i;
+        events_.insert(i, Event{time, pin, level});
+    }
+
+    /** Schedules the byte to be received from the sync wire at the given time. Lost if the CPU sleeps at that time, as the USART does not run in power down.
+     */
+    static void scheduleReceive(uint64_t time, uint8_t value) {
+        auto i = received_.begin();
+        while (i != received_.end() && i->time <= time)
+            ++i;
+        received_.insert(i, Event{time, 0, value});
+    }
+
+    /** Schedules an I2C master writing the bytes, the register index first, to the slave at the given time. Unlike the USART, the TWI slave runs in power down and its address match wakes the CPU up. The bytes the slave does not acknowledge end the write early.
+     */
+    static void scheduleI2CWrite(uint64_t time, std::vector<uint8_t> const & data) {
+        auto i = i2cWrites_.begin();
+        while (i != i2cWrites_.end() && i->time <= time)
+            ++i;
+        i2cWrites_.insert(i, I2CWrite{time, data});
+    }
+
+    /** Sets the bus event handlers of the I2C slave, i.e. its interrupt. The scheduled writes are delivered, and wake the CPU, only with a slave attached.
+     */
+    static void attachI2CSlave(void (*onAddress)(bool), bool (*onWrite)(uint8_t), void (*onStop)()) {
+        i2cAddress_ = onAddress;
+        i2cWrite_ = onWrite;
+        i2cStop_ = onStop;
+    }
+
+    /** Sets the handler of the bytes received from the sync wire, i.e. the receive interrupt.
+     */
+    static void attachReceiver(void (*handler)(uint8_t)) {
+        receiver_ = handler;
+    }
+
+    /** Records a byte sent to the sync wire at the current time.
+     */
+    static void transmit(uint8_t value) {
+        transmitted_.push_back(Event{now_, 0, value});
+    }
+
+    /** The bytes sent to the sync wire so far, with their times.
+     */
+    static size_t transmittedCount() {
+        return transmitted_.size();
+    }
+
+    static uint64_t transmittedTime(size_t i) {
+        return transmitted_[i].time;
+    }
+
+    static uint8_t transmittedValue(size_t i) {
+        return transmitted_[i].value;
+    }
+
+    /** Sets the error of the CPU clock in parts per million, positive when the clock is slow so that the delays take longer.
+     */
+    static void setClockError(int32_t ppm) {
+        clockError_ = ppm;
+    }
+
+    /** Returns the real time a delay of given microseconds takes with the error of the clock.
+     */
+    static uint64_t cpuTime(uint64_t us) {
+        return static_cast<uint64_t>(static_cast<int64_t>(us) + static_cast<int64_t>(us) * clockError_ / 1000000);
+    }
+
+    /** Runs the time forward, the CPU being in given state, applying the scheduled input changes and delivering the received bytes as their time comes.
+     */
+    static void advance(uint64_t us, CpuState state);
+
+    /** Sleeps until an input with an interrupt attached changes, or the I2C slave is written to. If there is no such wakeup scheduled, sleeps till the end of the simulation and throws Finished.
+     */
+    static void sleep() {
+        uint64_t wakeup = UINT64_MAX;
+        for (Event const & e : events_) {
+            if (interrupts_ & (1 << e.pin)) {
+                wakeup = e.time;
+                break;
+            }
+        }
+        if (i2cWrite_ != nullptr && ! i2cWrites_.empty() && i2cWrites_.front().time < wakeup)
+            wakeup = i2cWrites_.front().time;
+        if (wakeup != UINT64_MAX) {
+            advance(wakeup - now_, CpuState::Sleep);
+            return;
+        }
+        if (end_ > now_)
+            advance(end_ - now_, CpuState::Sleep);
+        throw Finished{};
+    }
+
+    /** Sets the end of the simulation, which is where an idle light goes to sleep.
+     */
+    static void setEnd(uint64_t time) {
+        end_ = time;
+    }
+
+    static uint64_t end() {
+        return end_;
+    }
+
+    static void pinMode(uint8_t pin, uint8_t mode) {
+        mode_[pin] = mode;
+    }
+
+    static bool isOutput(uint8_t pin) {
+        return mode_[pin] == OUTPUT;
+    }
+
+    /** Sets the output level of the pin as a PWM duty, 0 being low and 255 high.
+     */
+    static void write(uint8_t pin, uint8_t duty) {
+        if (duty_[pin] != duty)
+            changed_[pin] = now_;
+        duty_[pin] = duty;
+    }
+
+    /** Time the output of the pin last changed.
+     */
+    static uint64_t changed(uint8_t pin) {
+        return changed_[pin];
+    }
+
+    static uint8_t duty(uint8_t pin) {
+        return isOutput(pin) ? duty_[pin] : 0;
+    }
+
+    /** Outputs read what they drive, inputs the level set by the host, which is high unless set otherwise (the buttons have pullups).
+     */
+    static bool read(uint8_t pin) {
+        return isOutput(pin) ? (duty_[pin] != 0) : (inputs_ & (1 << pin));
+    }
+
+    static void attachInterrupt(uint8_t pin) {
+        interrupts_ |= (1 << pin);
+    }
+
+private:
+
+    /** Change of a pin's input level, or a byte of the sync wire, which has the byte as its value.
+     */
+    struct Event {
+        uint64_t time;
+        uint8_t pin;
+        uint8_t value;
+    };
+
+    struct I2CWrite {
+        uint64_t time;
+        std::vector<uint8_t> data;
+    };
+
+    /** Hands the write to the I2C slave as the address match, the bytes and the stop condition.
+     */
+    static void deliver(I2CWrite const & write) {
+        if (i2cWrite_ == nullptr)
+            return;
+        i2cAddress_(false);
+        for (uint8_t value : write.data)
+            if (! i2cWrite_(value))
+                break;
+        i2cStop_();
+    }
+
+    static inline uint64_t now_ = 0;
+    static inline uint64_t end_ = 0;
+    static inline int32_t clockError_ = 0;
+    static inline std::vector<Event> events_;
+    static inline std::vector<Event> received_;
+    static inline std::vector<Event> transmitted_;
+    static inline void (*receiver_)(uint8_t) = nullptr;
+    static inline std::vector<I2CWrite> i2cWrites_;
+    static inline void (*i2cAddress_)(bool) = nullptr;
+    static inline bool (*i2cWrite_)(uint8_t) = nullptr;
+    static inline void (*i2cStop_)() = nullptr;
+    static inline uint8_t mode_[PINS];
+    static inline uint8_t duty_[PINS];
+    static inline uint64_t changed_[PINS];
+    static inline uint16_t inputs_ = 0xffff;
+    static inline uint16_t interrupts_ = 0;
+
+}; // board
+
+/** Energy model of the light.
+
+    Integrates the current of the CPU in its active, idle and sleep states, of the white LED, whose current is proportional to its PWM duty, and of the neopixels, which draw a quiescent current per pixel and a current proportional to each channel value when their rail is powered. The neopixels take the bytes sent to them when they latch, i.e. when time passes after the update, and lose them when the rail is powered down.
+
+    The currents are estimates (CPU at 8MHz and 3.7V, WS2812B at full channel), to be refined with measurements of the light. The host program attaches the loads to their pins. The consumed charge is kept per load.
+ */
+class energy {
+public:
+
+    enum class Load : uint8_t {
+        Cpu,
+        White,
+        Neopixels,
+    };
+
+    static constexpr uint8_t LOADS = 3;
+
+    // currents in mA
+    static inline double cpuActive = 2.0;
+    static inline double cpuIdle = 0.7;
+    static inline double cpuSleep = 0.001;
+    static inline double neopixelQuiescent = 1.0;
+    static inline double neopixelChannel = 20.0;
+
+    /** Attaches the white LED, drawing given current at full duty, to its PWM pin.
+     */
+    static void attachWhite(uint8_t pin, double current) {
+        whitePin_ = pin;
+        whiteCurrent_ = current;
+    }
+
+    /** Attaches the neopixels powered by a rail switched by given pin, which is on when low.
+     */
+    static void attachNeopixels(uint8_t railPin, uint16_t pixels) {
+        railPin_ = railPin;
+        pixels_ = pixels;
+    }
+
+    /** Bytes sent to the neopixels, each scaled by (scale + 1) / 256 like the bit loop does, which the neopixels take when they latch.
+     */
+    static void neopixelSend(uint8_t const * data, uint16_t count, uint8_t scale) {
+        if (! pending_) {
+            pending_ = true;
+            pendingSum_ = 0;
+            sent_ = board::now();
+        }
+        while (count-- > 0)
+            pendingSum_ += (*(data++) * (scale + 1)) >> 8;
+    }
+
+    /** Time of the last update sent to the neopixels, and whether the neopixels are powered and lit by it.
+     */
+    static uint64_t neopixelsSent() {
+        return sent_;
+    }
+
+    static bool neopixelsLit() {
+        bool rail = railPin_ >= 0 && board::isOutput(railPin_) && board::duty(railPin_) == 0;
+        return rail && (pending_ ? pendingSum_ : channelSum_) > 0;
+    }
+
+    /** Adds the charge drawn over the given time with the CPU in given state.
+     */
+    static void integrate(uint64_t us, board::CpuState state) {
+        bool rail = railPin_ >= 0 && board::isOutput(railPin_) && board::duty(railPin_) == 0;
+        if (! rail)
+            channelSum_ = 0;
+        else if (pending_)
+            channelSum_ = pendingSum_;
+        pending_ = false;
+        double cpu = state == board::CpuState::Active ? cpuActive : state == board::CpuState::Idle ? cpuIdle : cpuSleep;
+        double white = whitePin_ >= 0 ? whiteCurrent_ * board::duty(whitePin_) / 255 : 0;
+        double neopixels = rail ? pixels_ * neopixelQuiescent + channelSum_ * neopixelChannel / 255 : 0;
+        double hours = us / 3600e6;
+        charge_[static_cast<uint8_t>(Load::Cpu)] += cpu * hours;
+        charge_[static_cast<uint8_t>(Load::White)] += white * hours;
+        charge_[static_cast<uint8_t>(Load::Neopixels)] += neopixels * hours;
+        if (state == board::CpuState::Sleep) {
+            sleepCharge_ += (cpu + white + neopixels) * hours;
+            sleepTime_ += us;
+        }
+    }
+
+    /** Charge drawn by the load so far, in mAh.
+     */
+    static double charge(Load load) {
+        return charge_[static_cast<uint8_t>(load)];
+    }
+
+    /** Total charge drawn so far, in mAh.
+     */
+    static double charge() {
+        return charge_[0] + charge_[1] + charge_[2];
+    }
+
+    /** Charge drawn while the CPU was asleep, in mAh, and the time it slept, in microseconds.
+     */
+    static double sleepCharge() {
+        return sleepCharge_;
+    }
+
+    static uint64_t sleepTime() {
+        return sleepTime_;
+    }
+
+private:
+
+    static inline int whitePin_ = -1;
+    static inline double whiteCurrent_ = 0;
+    static inline int railPin_ = -1;
+    static inline uint16_t pixels_ = 0;
+    static inline bool pending_ = false;
+    static inline uint32_t pendingSum_ = 0;
+    static inline uint32_t channelSum_ = 0;
+    static inline uint64_t sent_ = 0;
+    static inline double charge_[LOADS];
+    static inline double sleepCharge_ = 0;
+    static inline uint64_t sleepTime_ = 0;
+
+}; // energy
+
+inline void board::advance(uint64_t us, CpuState state) {
+    uint64_t until = now_ + us;
+    while (true) {
+        bool pin = ! events_.empty() && events_.front().time <= until;
+        bool byte = ! received_.empty() && received_.front().time <= until;
+        bool write = ! i2cWrites_.empty() && i2cWrites_.front().time <= until;
+        // the I2C writes go after the pin changes and received bytes of the same time
+        if (write && ! (pin && events_.front().time <= i2cWrites_.front().time) && ! (byte && received_.front().time <= i2cWrites_.front().time)) {
+            I2CWrite w = i2cWrites_.front();
+            i2cWrites_.erase(i2cWrites_.begin());
+            if (w.time > now_) {
+                energy::integrate(w.time - now_, state);
+                now_ = w.time;
+            }
+            deliver(w);
+            continue;
+        }
+        if (! pin && ! byte)
+            break;
+        // the earlier of the pin change and the received byte, pins first
+        if (pin && byte)
+            byte = received_.front().time < events_.front().time;
+        std::vector<Event> & queue = byte ? received_ : events_;
+        Event e = queue.front();
+        queue.erase(queue.begin());
+        if (e.time > now_) {
+            energy::integrate(e.time - now_, state);
+            now_ = e.time;
+        }
+        if (byte) {
+            if (state != CpuState::Sleep && receiver_ != nullptr)
+                receiver_(e.value);
+        } else if (e.value) {
+            inputs_ |= (1 << e.pin);
+        } else {
+            inputs_ &= ~(1 << e.pin);
+        }
+    }
+    energy::integrate(until - now_, state);
+    now_ = until;
+}
+
+/** Arduino API, on top of the board.
+ */
+
+inline void pinMode(uint8_t pin, uint8_t mode) {
+    board::pinMode(pin, mode);
+}
+
+inline void digitalWrite(uint8_t pin, uint8_t value) {
+    board::write(pin, value ? 255 : 0);
+}
+
+inline uint8_t digitalRead(uint8_t pin) {
+    return board::read(pin) ? HIGH : LOW;
+}
+
+inline void analogWrite(uint8_t pin, uint8_t value) {
+    board::pinMode(pin, OUTPUT);
+    board::write(pin, value);
+}
+
+inline uint8_t digitalPinToInterrupt(uint8_t pin) {
+    return pin;
+}
+
+inline void attachInterrupt(uint8_t pin, void (*)(), uint8_t) {
+    board::attachInterrupt(pin);
+}
+
+inline uint8_t digitalPinToPort(uint8_t pin) {
+    return pin;
+}
+
+inline uint8_t digitalPinToBitMask(uint8_t pin) {
+    return 1 << (pin & 7);
+}
+
+/** There are no ports, the neopixels get their data directly from the driver.
+ */
+inline volatile uint8_t * portOutputRegister(uint8_t) {
+    static volatile uint8_t port;
+    return & port;
+}
+
+/** Random number in [min, max), min for an empty range, like the Arduino core. 
+ */
+inline long random(long min, long max) {
+    if (max <= min)
+        return min;
+    return min + rand() % (max - min);
+}
+
+inline unsigned long micros() {
+    return static_cast<unsigned long>(board::now());
+}
+
+inline unsigned long millis() {
+    return static_cast<unsigned long>(board::now() / 1000);
+}
+
+/** Like on megaTinyCore, the delays are busy waits.
+ */
+inline void delayMicroseconds(unsigned us) {
+    board::advance(board::cpuTime(us), board::CpuState::Active);
+}
+
+inline void delay(unsigned long ms) {
+    board::advance(board::cpuTime(static_cast<uint64_t>(ms) * 1000), board::CpuState::Active);
+}
+
+class cpu {
+public:
+    static void delay_us(unsigned value) {
+        delayMicroseconds(value);
+    }
+
+    /** Idles like on megaTinyCore, see arduino.h.
+     */
+    static void delay_ms(unsigned value) {
+        board::advance(board::cpuTime(static_cast<uint64_t>(value) * 1000), board::CpuState::Idle);
+    }
+
+    /** Powers the CPU down until woken up by an interrupt.
+     */
+    static void sleep() {
+        board::sleep();
+    }
+
+}; // cpu
+
+class wdt {
+public:
+    static void enable() {}
+    static void disable() {}
+    static void reset() {}
+}; // wdt
+
+/** EEPROM, kept in memory for the duration of the run, starts erased.
+ */
+class eeprom {
+public:
+
+    static constexpr uint16_t SIZE = 256;
+
+    static uint8_t read(uint16_t address) {
+        return data()[address % SIZE];
+    }
+
+    static void read(uint16_t address, uint8_t * buffer, uint8_t size) {
+        while (size-- > 0)
+            *(buffer++) = read(address++);
+    }
+
+    static void write(uint16_t address, uint8_t const * buffer, uint8_t size) {
+        ++writes_;
+        while (size-- > 0)
+            data()[(address++) % SIZE] = *(buffer++);
+    }
+
+    static void wait() {}
+
+    /** Number of writes so far.
+     */
+    static uint32_t writes() {
+        return writes_;
+    }
+
+private:
+
+    static uint8_t * data() {
+        static uint8_t data[SIZE];
+        static bool erased = (memset(data, 0xff, SIZE), true);
+        (void)erased;
+        return data;
+    }
+
+    static inline uint32_t writes_ = 0;
+
+}; // eeprom
+
+class gpio {
+public:
+    using Pin = int;
+    static constexpr Pin UNUSED = -1;
+
+    static void initialize() {}
+
+    static void output(Pin pin) {
+        pinMode(pin, OUTPUT);
+    }
+
+    static void input(Pin pin) {
+        pinMode(pin, INPUT);
+    }
+
+    static void inputPullup(Pin pin) {
+        pinMode(pin, INPUT_PULLUP);
+    }
+
+    static void high(Pin pin) {
+        digitalWrite(pin, HIGH);
+    }
+
+    static void low(Pin pin) {
+        digitalWrite(pin, LOW);
+    }
+
+    static bool read(Pin pin) {
+        return digitalRead(pin);
+    }
+}; // gpio
+
+/** There are no I2C devices for the master on the mock bus. The slave is written to by the master writes the host schedules, see board::scheduleI2CWrite().
+ */
+class i2c {
+public:
+
+    static void initializeMaster() {}
+
+    static void initializeSlave(uint8_t, bool = false) {}
+
+    static bool transmit(uint8_t, uint8_t const *, uint8_t, uint8_t *, uint8_t) {
+        return false;
+    }
+
+}; // i2c
+
+class adc {
+public:
+
+    /** Returns the supply voltage in millivolts, as set by the host, unknown (0) unless set.
+     */
+    static uint16_t readVcc() {
+        return vcc_;
+    }
+
+    /** Returns the voltage on given pin as set by the host, 0 unless set. 
+     */
+    static uint16_t read(uint8_t pin) {
+        return levels_[pin];
+    }
+
+    /** Returns the temperature of the chip in 1/16 K, as set by the host, 25C unless set.
+     */
+    static uint16_t readTemperature() {
+        return temperature_;
+    }
+
+    static void setVcc(uint16_t mv) {
+        vcc_ = mv;
+    }
+
+    static void setTemperature(uint16_t temperature) {
+        temperature_ = temperature;
+    }
+
+    /** Sets the voltage on given pin as a 10 bit reading against VDD. 
+     */
+    static void setLevel(uint8_t pin, uint16_t level) {
+        levels_[pin] = level;
+    }
+
+private:
+
+    static inline uint16_t vcc_ = 0;
+    static inline uint16_t temperature_ = (273 + 25) * 16;
+    static inline uint16_t levels_[board::PINS];
+
+}; // adc
+
+/** The host talks to the USART driver directly, see e.g. SerialRegisters::onReceive() and onTransmit().
+ */
+class uart {
+public:
+
+    static void initialize(uint32_t, bool = false) {}
+
+    static void startTransmit() {}
+
+}; // uart
+
+/** The sync wire, see the board for how the host connects several lights. Sending takes its 10 bit times per byte.
+ */
+class syncwire {
+public:
+
+    static constexpr uint32_t BAUDRATE = 38400;
+
+    static void initializeTransmitter() {}
+
+    static void initializeReceiver() {}
+
+    static void send(uint8_t const * data, uint8_t size) {
+        while (size-- > 0) {
+            board::transmit(*(data++));
+            board::advance(board::cpuTime(10 * 1000000 / BAUDRATE), board::CpuState::Active);
+        }
+    }
+
+}; // syncwire
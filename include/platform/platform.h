@@ -7,6 +7,7 @@
 #if (defined ARCH_MOCK)
 #elif (defined ARCH_RPI)
 #elif (defined ARCH_ARDUINO)
+#elif (defined ARCH_AVR_BAREMETAL)
 #elif (defined ARCH_RPI2040)
 #elif (defined ARDUINO)
     #define ARCH_ARDUINO
@@ -33,7 +34,8 @@
 
 #if (defined ARCH_MOCK)
     #include "mock.h"
-#elif (defined ARCH_ARDUINO)
+#elif (defined ARCH_ARDUINO) || (defined ARCH_AVR_BAREMETAL)
+    // the bare-metal platform only replaces the Arduino core, see baremetal.h
     #include "arduino.h"
 #elif (defined ARCH_RP2040)
     #include "rp2040.h"
@@ -24,6 +24,21 @@ void setOrClear(T & value, V mask, bool setOrClear) {
         value &= ~mask;
 }
 
+/** Linear interpolation between two 8bit values, amount going from 0 (from) to 256 (to). 
+ */
+inline uint8_t Lerp(uint8_t from, uint8_t to, uint16_t amount) {
+    if (to >= from)
+        return from + ((static_cast<uint16_t>(to - from) * amount) >> 8);
+    else
+        return from - ((static_cast<uint16_t>(from - to) * amount) >> 8);
+}
+
+/** Scales the 8bit value by (scale + 1) / 256, so that 255 keeps the value. A single 8x8bit multiplication.
+ */
+inline uint8_t Scale8(uint8_t value, uint8_t scale) {
+    return (static_cast<uint16_t>(value) * scale + value) >> 8;
+}
+
 /** Returns true if given string ends with the given suffix. 
  
     Does not use the evil string object. 
@@ -55,6 +70,19 @@ inline char ToHex(uint8_t value) {
         return '?'; // error
 }
 
+/** CRC-8 (polynomial 0x07) of the given bytes. 
+ 
+    The initial value can be used to chain the calculation, or to salt the checksum. Bitwise, since the tables would be larger than the data we checksum. 
+ */
+inline uint8_t CRC8(uint8_t const * data, uint8_t size, uint8_t crc = 0) {
+    while (size-- > 0) {
+        crc ^= *(data++);
+        for (uint8_t i = 0; i < 8; ++i)
+            crc = (crc & 0x80) ? static_cast<uint8_t>((crc << 1) ^ 0x07) : static_cast<uint8_t>(crc << 1);
+    }
+    return crc;
+}
+
 #if (defined ARCH_MOCK | defined ARCH_RPI)
 
 #include <sstream>
@@ -0,0 +1,11 @@
+#pragma once
+// Generated by bin/cuec.py from shows/example.cue, do not edit.
+
+#include "platform/platform.h"
+
+constexpr uint8_t SHOW_CUES[] PROGMEM = {
+    0x02, 0x00, 0x00, 0x00, 0x03, 0x00, 0x00, 0x00, 0x00, 0x00, 0x03, 0xff, 0x60, 0x00, 0xf4, 0x01,
+    0x01, 0xf4, 0x01, 0x03, 0x30, 0x10, 0x60, 0x20, 0x03, 0x01, 0x20, 0x03, 0x02, 0x30, 0xc8, 0x00,
+    0x04, 0x01, 0x01, 0xe8, 0x03, 0x03, 0x00, 0x00, 0x20, 0x2c, 0x01, 0x05, 0x02, 0x04, 0x02, 0x01,
+    0xc8, 0x00, 0x04, 0x01, 0x06, 0x2b, 0x00, 0x00,
+};
@@ -35,11 +35,45 @@ public:
         return Color{r, g, b};
     }        
 
-    /** Creates color based on the HSV model coordinates. 
+    /** Creates color based on the HSV model coordinates, the hue going from 0 to 255, where 255 is the same red as 0. 
+     
+        Uses the color wheel table (HSVWheel), or the calculation of the Adafruit Neopixel library (HSVExact) when built with HSV_EXACT. Both give the very same colors, which bin/hostcheck.py verifies for all inputs. 
+     */
+    static Color HSV(uint8_t h, uint8_t s, uint8_t v) {
+#if (defined HSV_EXACT)
+        return HSVExact(h, s, v);
+#else
+        return HSVWheel(h, s, v);
+#endif
+    }
+
+    /** HSV from the color wheel in flash. 
+     
+        The hexcone is the same for all three channels, only shifted by a third of the wheel, so the wheel is a single 256 byte table of the red channel and green and blue are read 85 and 170 hues behind it. The hexcone has only 255 distinct 8bit hues and the table's last entry repeats the first, hence the offsets wrap around at 255. Saturation and value are then applied with 8x8bit multiplications (Scale8) and skipped when at 255, which the RGB mode's saturation always is. 
+     */
+    static Color HSVWheel(uint8_t h, uint8_t s, uint8_t v) {
+        uint8_t red = pgm_read_byte(wheel_ + h);
+        uint8_t green = pgm_read_byte(wheel_ + (h >= 85 ? h - 85 : h + 170));
+        uint8_t blue = pgm_read_byte(wheel_ + (h >= 170 ? h - 170 : h + 85));
+        if (s != 255) {
+            uint8_t s2 = 255 - s;
+            red = Scale8(red, s) + s2;
+            green = Scale8(green, s) + s2;
+            blue = Scale8(blue, s) + s2;
+        }
+        if (v != 255) {
+            red = Scale8(red, v);
+            green = Scale8(green, v);
+            blue = Scale8(blue, v);
+        }
+        return Color{red, green, blue};
+    }
+
+    /** HSV calculated by the hexcone. 
      
         The code is straight from Adafruit Neopixel library.
      */
-    static Color HSV(uint16_t h, uint8_t s, uint8_t v) {
+    static Color HSVExact(uint16_t h, uint8_t s, uint8_t v) {
         uint8_t red, green, blue;
         // Remap 0-65535 to 0-1529. Pure red is CENTERED on the 64K rollover;
         // 0 is not the start of pure red, but the midpoint...a few values above
@@ -115,6 +149,12 @@ public:
         return Color{red, green, blue};
     }
 
+    /** Blends two colors, amount going from 0 (a) to 256 (b). 
+     */
+    static Color Blend(Color const & a, Color const & b, uint16_t amount) {
+        return Color{Lerp(a.r, b.r, amount), Lerp(a.g, b.g, amount), Lerp(a.b, b.b, amount)};
+    }
+
     Color & operator = (Color const &) = default;
 
     void operator = (Color const & from) volatile {
@@ -194,45 +234,136 @@ private:
             channel -= step;
         return true;
     }
+
+    // red channel of the hexcone for the 256 hues, green and blue are read behind it (see HSVWheel)
+    static constexpr uint8_t wheel_[256] PROGMEM = {
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 252, 246, 240, 234, 228, 222, 216, 210, 204, 198, 192, 186, 180, 174, 168, 162, 156, 150, 144, 138, 132,
+        126, 120, 114, 108, 102, 96, 90, 84, 78, 72, 66, 60, 54, 48, 42, 36, 30, 24, 18, 12, 6, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0,
+        0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 0, 6, 12, 18, 24, 30, 36, 42, 48, 54, 60, 66, 72, 78, 84, 90, 96, 102, 108, 114, 120, 126,
+        132, 138, 144, 150, 156, 162, 168, 174, 180, 186, 192, 198, 204, 210, 216, 222, 228, 234, 240, 246, 252, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+        255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255, 255,
+    };
     
 } __attribute__((packed));
 
+/** Palette of 16 colors stored in flash. 
+
+    The palette is indexed by 0-255 and blends between the two nearest stops, so that each lookup costs reading two stops and a single blend with no divisions. The stops are given as 16 r, g, b triples in PROGMEM, see utils/palettes.h for the predefined ones. 
+    
+    Cyclic palettes wrap around, i.e. indices above 240 blend from the last stop back to the first, which is what scrolling through the palette needs. Gradients do not wrap and stay at the last stop instead. 
+ */
+class Palette {
+public:
+
+    static constexpr uint8_t STOPS = 16;
+
+    constexpr Palette(uint8_t const (& stops)[STOPS * 3], bool cyclic = true):
+        stops_{stops},
+        cyclic_{cyclic} {
+    }
+
+    /** Returns the given stop.
+     */
+    Color stop(uint8_t index) const {
+        uint8_t const * x = stops_ + index * 3;
+        return Color::RGB(pgm_read_byte(x), pgm_read_byte(x + 1), pgm_read_byte(x + 2));
+    }
+
+    /** Returns the color at given index, blended from the two nearest stops.
+     */
+    Color operator [] (uint8_t index) const {
+        uint8_t const * a = stops_ + (index >> 4) * 3;
+        uint8_t const * b = a + 3;
+        if (index >= 240)
+            b = cyclic_ ? stops_ : a;
+        uint16_t amount = (index & 0x0f) << 4;
+        return Color::RGB(
+            Lerp(pgm_read_byte(a), pgm_read_byte(b), amount),
+            Lerp(pgm_read_byte(a + 1), pgm_read_byte(b + 1), amount),
+            Lerp(pgm_read_byte(a + 2), pgm_read_byte(b + 2), amount)
+        );
+    }
+
+private:
+    uint8_t const * stops_;
+    bool cyclic_;
+}; // Palette
+
 /** Array of N pixels that supports basic drawing and effects. 
+
+    Keeps the sum of all channels of all pixels, which e.g. the current limit of the neopixels needs, up to date as the pixels change, so that it costs a few additions per changed pixel instead of a pass over the strip. So the pixels are only read by operator[] and changed by set() and the drawing methods.
  */
 template<uint16_t SIZE>
 class ColorStrip {
 public:
-    Color & operator[](unsigned index) {
-        changed_ = true;
+    Color const & operator[](unsigned index) const {
         return colors_[index];
     }
 
+    /** Sets the pixel at given index.
+     */
+    void set(uint16_t index, Color const & color) {
+        changed_ = setPixel(index, color) | changed_;
+    }
+
+    /** Returns the sum of all channels of all pixels, i.e. 765 per pixel at full white.
+     */
+    uint32_t channelSum() const {
+        return sum_;
+    }
+
     void fill(Color const & color, uint8_t step = 255) {
         for (uint8_t i = 0; i < SIZE; ++i) {
-            changed_ = colors_[i].moveTowards(color, step) | changed_;
+            changed_ = movePixel(i, color, step) | changed_;
         }
     }
 
     void withBrightness(uint8_t brightness) {
         for (uint8_t i = 0; i < SIZE; ++i) {
-            Color c = colors_[i].withBrightness(brightness);
-            if (c != colors_[i]) {
-                colors_[i] = c;
-                changed_ = true; 
-            }
+            changed_ = setPixel(i, colors_[i].withBrightness(brightness)) | changed_;
+        }
+    }
+
+    /** Sets the pixels to the blend of the two strips, amount going from 0 (from) to 256 (to). 
+     */
+    void blend(ColorStrip<SIZE> const & from, ColorStrip<SIZE> const & to, uint16_t amount) {
+        for (uint8_t i = 0; i < SIZE; ++i) {
+            changed_ = setPixel(i, Color::Blend(from.colors_[i], to.colors_[i], amount)) | changed_;
+        }
+    }
+
+    /** Fills the strip from the palette, starting at given index and moving by delta, in 1/256 of an index (8.8 fixed point), for every pixel. By default the strip spans the whole palette once, also when it has more than 256 pixels. 
+     */
+    void fillPalette(Palette const & palette, uint8_t start, uint16_t delta = static_cast<uint16_t>(65536 / SIZE), uint8_t step = 255) {
+        uint16_t index = static_cast<uint16_t>(start) << 8;
+        for (uint16_t i = 0; i < SIZE; ++i) {
+            changed_ = movePixel(i, palette[index >> 8], step) | changed_;
+            index += delta;
+        }
+    }
+
+    /** Sets each pixel to the palette color at the index returned by index(i), e.g. a heat value for a fire. 
+     */
+    template<typename F>
+    void mapPalette(Palette const & palette, F index, uint8_t step = 255) {
+        for (uint16_t i = 0; i < SIZE; ++i) {
+            changed_ = movePixel(i, palette[index(i)], step) | changed_;
         }
     }
 
     bool moveTowards(ColorStrip<SIZE> const & other, uint8_t step = 1) {
         for (uint8_t i = 0; i < SIZE; ++i) {
-            changed_ = colors_[i].moveTowards(other.colors_[i], step) | changed_;
+            changed_ = movePixel(i, other.colors_[i], step) | changed_;
         }
         return changed_;
     }
 
     bool moveTowardsReversed(ColorStrip<SIZE> const & other, uint8_t step = 1) {
         for (uint8_t i = 0; i < SIZE; ++i) {
-            changed_ = colors_[i].moveTowards(other.colors_[SIZE - 1 - i], step) | changed_;
+            changed_ = movePixel(i, other.colors_[SIZE - 1 - i], step) | changed_;
         }
         return changed_;
     }
@@ -257,7 +388,7 @@ public:
                 v -= b; // we know it
                 offset = 0;
             }
-            changed_ = colors_[i].moveTowards(color.withBrightness(b), step) | changed_;
+            changed_ = movePixel(i, color.withBrightness(b), step) | changed_;
         }
     }
 
@@ -268,7 +399,7 @@ public:
         for (uint8_t i = 0; i < SIZE; ++i) {
             uint8_t b = v > 255 ? 255 : (v & 0xff);
             v -= b;
-            changed_ = colors_[i].moveTowards(color.withBrightness(b), step) | changed_;
+            changed_ = movePixel(i, color.withBrightness(b), step) | changed_;
         }
     }
 
@@ -285,7 +416,7 @@ public:
             if (v < b)
                 b = v;
             v -= b;
-            changed_ = colors_[i].moveTowards(color.withBrightness(b), step) | changed_;
+            changed_ = movePixel(i, color.withBrightness(b), step) | changed_;
         }
     }
 
@@ -294,6 +425,48 @@ public:
     }
 
 protected:
-    Color colors_[SIZE];
+
+    /** Returns the pixels to output, or nullptr if they did not change since the last output. 
+     */
+    Color const * takeFrame() {
+        if (! changed_)
+            return nullptr;
+        changed_ = false;
+        return colors_;
+    }
+
+    /** The frame returned by the last takeFrame(), to be sent again.
+     */
+    Color const * lastFrame() const {
+        return colors_;
+    }
+
+    static uint16_t Channels(Color const & color) {
+        return static_cast<uint16_t>(color.r) + color.g + color.b;
+    }
+
+    /** Sets the pixel, keeping the channel sum. Returns true if the pixel changed.
+     */
+    bool setPixel(uint16_t i, Color const & color) {
+        if (color == colors_[i])
+            return false;
+        sum_ = sum_ - Channels(colors_[i]) + Channels(color);
+        colors_[i] = color;
+        return true;
+    }
+
+    /** Moves the pixel towards the color, keeping the channel sum. Returns true if the pixel changed.
+     */
+    bool movePixel(uint16_t i, Color const & color, uint8_t step) {
+        uint16_t before = Channels(colors_[i]);
+        if (! colors_[i].moveTowards(color, step))
+            return false;
+        sum_ = sum_ - before + Channels(colors_[i]);
+        return true;
+    }
+
+    // black, which the sum starts at
+    Color colors_[SIZE] = {};
     bool changed_ = false;
-}; // ColorStrip
\ No newline at end of file
+    uint32_t sum_ = 0;
+}; // ColorStrip
@@ -0,0 +1,161 @@
+#pragma once
+
+#include "utils/transition.h"
+
+/** Cue list player.
+
+    Runs a show, a compact bytecode program stored in flash, that fades the white and RGB outputs, waits, switches effects and waits for buttons. Programs are compiled from text cue files by bin/cuec.py. Each instruction is an opcode byte followed by its arguments, 16bit arguments are little endian:
+
+        End                           stops the show, outputs keep their values
+        Wait ticks16                  the next instruction executes ticks later
+        White level ticks16           starts fading the white output to level
+        RGB r g b ticks16             starts fading the RGB output to the color
+        Effect id                     sets the effect applied to the white output (interpreted by the firmware)
+        Button mask                   waits until any of the buttons in the mask is pressed
+        Jump address16                continues at given offset from the start of the program
+
+    Fades run in the background, so white and RGB can fade at the same time and the program continues immediately. A fade over N ticks reaches its target exactly N ticks after it started, and waits are exact to the tick too.
+
+    The cost of a tick is bounded. The fades are linear Transitions, the only division happens once when a fade starts, and at most MAX_STEPS instructions are executed per tick (a program looping without waiting therefore does not stall the firmware). The waits are exact only while the instructions from one wait or button to the next, the wait included, fit MAX_STEPS, as the rest would run in the next tick. bin/cuec.py rejects programs that do not. No memory is allocated.
+ */
+class CuePlayer {
+public:
+
+    enum class Op : uint8_t {
+        End,
+        Wait,
+        White,
+        RGB,
+        Effect,
+        Button,
+        Jump,
+    };
+
+    static constexpr uint8_t MAX_STEPS = 4;
+
+    /** Starts the given program with the outputs at their current values.
+     */
+    void start(uint8_t const * program, uint8_t white, Color const & color) {
+        program_ = program;
+        pc_ = 0;
+        wait_ = 0;
+        buttons_ = 0;
+        effect_ = 0;
+        whiteFrom_ = white;
+        whiteTo_ = white;
+        whiteFade_.stop();
+        colorFrom_ = color;
+        colorTo_ = color;
+        colorFade_.stop();
+        running_ = true;
+    }
+
+    void stop() {
+        running_ = false;
+    }
+
+    bool running() const {
+        return running_;
+    }
+
+    uint8_t white() const {
+        return whiteFade_.apply(whiteFrom_, whiteTo_);
+    }
+
+    Color color() const {
+        return colorFade_.apply(colorFrom_, colorTo_);
+    }
+
+    uint8_t effect() const {
+        return effect_;
+    }
+
+    /** Clears the effect, for effects that finish on their own.
+     */
+    void clearEffect() {
+        effect_ = 0;
+    }
+
+    /** Advances the show by one tick.
+
+        The pressed argument is a mask of buttons pressed since the last tick.
+     */
+    void tick(uint8_t pressed) {
+        whiteFade_.tick();
+        colorFade_.tick();
+        if (! running_)
+            return;
+        if (buttons_ != 0) {
+            if ((pressed & buttons_) == 0)
+                return;
+            buttons_ = 0;
+        }
+        if (wait_ > 0 && --wait_ > 0)
+            return;
+        for (uint8_t i = 0; i < MAX_STEPS; ++i)
+            if (! step())
+                return;
+    }
+
+private:
+
+    uint8_t next() {
+        return pgm_read_byte(program_ + pc_++);
+    }
+
+    uint16_t next16() {
+        uint8_t lo = next();
+        return lo | (next() << 8);
+    }
+
+    /** Executes a single instruction, returns false if the program should not continue in this tick.
+     */
+    bool step() {
+        switch (static_cast<Op>(next())) {
+            case Op::Wait:
+                wait_ = next16();
+                return wait_ == 0;
+            case Op::White:
+                whiteFrom_ = white();
+                whiteTo_ = next();
+                whiteFade_.start(next16());
+                return true;
+            case Op::RGB: {
+                colorFrom_ = color();
+                uint8_t r = next();
+                uint8_t g = next();
+                uint8_t b = next();
+                colorTo_ = Color::RGB(r, g, b);
+                colorFade_.start(next16());
+                return true;
+            }
+            case Op::Effect:
+                effect_ = next();
+                return true;
+            case Op::Button:
+                buttons_ = next();
+                return false;
+            case Op::Jump:
+                pc_ = next16();
+                return true;
+            case Op::End:
+            default:
+                running_ = false;
+                return false;
+        }
+    }
+
+    uint8_t const * program_ = nullptr;
+    uint16_t pc_ = 0;
+    uint16_t wait_ = 0;
+    uint8_t buttons_ = 0;
+    uint8_t effect_ = 0;
+    bool running_ = false;
+    uint8_t whiteFrom_ = 0;
+    uint8_t whiteTo_ = 0;
+    Transition whiteFade_;
+    Color colorFrom_;
+    Color colorTo_;
+    Transition colorFade_;
+
+}; // CuePlayer
@@ -0,0 +1,167 @@
+#pragma once
+
+#include "platform/platform.h"
+
+/** Compile time effect engine.
+
+    Each effect is a type that provides:
+
+        struct State { ... };                 // trivial state of the effect
+        static constexpr uint8_t PERIOD;      // ticks between updates
+        static constexpr uint16_t BUDGET;     // declared worst case cycles of a single update
+        static void enter(State & state);     // called when the effect becomes active
+        static void update(State & state);    // called every PERIOD ticks while active
+
+    The effects are registered as the template arguments of Effects. Only one effect is active at a time and only its state is live, so the states share storage in a union. Dispatch is resolved at compile time into a chain of comparisons, and the engine only calls the active effect when its period elapses, so adding effects does not slow down the others.
+
+    The effect ids are the indices of the effects in the template argument list.
+ */
+template<typename... EFFECTS>
+class Effects {
+    // compile time helpers, need to be declared before they are used below
+
+    template<typename A, typename B>
+    struct IsSame {
+        static constexpr bool value = false;
+    };
+
+    template<typename A>
+    struct IsSame<A, A> {
+        static constexpr bool value = true;
+    };
+
+    template<typename E, typename FIRST, typename... REST>
+    static constexpr uint8_t IdOf() {
+        if constexpr (IsSame<E, FIRST>::value) {
+            return 0;
+        } else {
+            static_assert(sizeof...(REST) > 0, "Effect not registered");
+            return 1 + IdOf<E, REST...>();
+        }
+    }
+
+    template<typename FIRST, typename... REST>
+    static constexpr uint16_t MaxBudget() {
+        if constexpr (sizeof...(REST) == 0) {
+            return FIRST::BUDGET;
+        } else {
+            uint16_t rest = MaxBudget<REST...>();
+            return FIRST::BUDGET > rest ? FIRST::BUDGET : rest;
+        }
+    }
+
+public:
+
+    static constexpr uint8_t COUNT = sizeof...(EFFECTS);
+
+    /** Largest declared budget of all effects, i.e. the worst case cost of a single tick.
+     */
+    static constexpr uint16_t MAX_BUDGET = MaxBudget<EFFECTS...>();
+
+    static_assert(COUNT > 0 && COUNT < 255, "Invalid number of effects");
+
+    template<typename E>
+    static constexpr uint8_t id() {
+        return IdOf<E, EFFECTS...>();
+    }
+
+    uint8_t current() const {
+        return current_;
+    }
+
+    template<typename E>
+    bool is() const {
+        return current_ == id<E>();
+    }
+
+    template<typename E>
+    typename E::State & state() {
+        return states_.template get<E>();
+    }
+
+    /** Activates the given effect. Its first update happens on the next tick.
+     */
+    template<typename E>
+    void enter() {
+        current_ = id<E>();
+        countdown_ = 0;
+        E::enter(state<E>());
+    }
+
+    /** Activates the effect with given id, ignoring invalid ids.
+     */
+    void enter(uint8_t id) {
+        enterById<0, EFFECTS...>(id);
+    }
+
+    /** Advances the engine by one tick, updating the active effect if its period has elapsed.
+     */
+    void tick() {
+        if (countdown_ > 0) {
+            --countdown_;
+            return;
+        }
+        updateById<0, EFFECTS...>(current_);
+    }
+
+    /** Schedules the updates of the active effect on the ticks of a timebase that are multiples of its period, e.g. so that several lights sharing the timebase update in step. Must be called before tick() with the timebase of that tick, the period of the timebase should be a multiple of the effect periods.
+     */
+    void align(uint16_t ticks) {
+        alignById<0, EFFECTS...>(current_, ticks);
+    }
+
+private:
+
+    template<uint8_t ID, typename FIRST, typename... REST>
+    void enterById(uint8_t id) {
+        if (id == ID)
+            enter<FIRST>();
+        else if constexpr (sizeof...(REST) > 0)
+            enterById<ID + 1, REST...>(id);
+    }
+
+    template<uint8_t ID, typename FIRST, typename... REST>
+    void updateById(uint8_t id) {
+        if (id == ID) {
+            countdown_ = FIRST::PERIOD - 1;
+            FIRST::update(state<FIRST>());
+        } else if constexpr (sizeof...(REST) > 0) {
+            updateById<ID + 1, REST...>(id);
+        }
+    }
+
+    template<uint8_t ID, typename FIRST, typename... REST>
+    void alignById(uint8_t id, uint16_t ticks) {
+        if (id == ID) {
+            uint8_t phase = ticks % FIRST::PERIOD;
+            countdown_ = phase == 0 ? 0 : FIRST::PERIOD - phase;
+        } else if constexpr (sizeof...(REST) > 0) {
+            alignById<ID + 1, REST...>(id, ticks);
+        }
+    }
+
+    /** Union of the effect states.
+     */
+    template<typename... ES>
+    union States {
+    };
+
+    template<typename FIRST, typename... REST>
+    union States<FIRST, REST...> {
+        typename FIRST::State first;
+        States<REST...> rest;
+
+        template<typename E>
+        typename E::State & get() {
+            if constexpr (IsSame<E, FIRST>::value)
+                return first;
+            else
+                return rest.template get<E>();
+        }
+    };
+
+    States<EFFECTS...> states_;
+    uint8_t current_ = 0;
+    uint8_t countdown_ = 0;
+
+}; // Effects
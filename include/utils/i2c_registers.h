@@ -0,0 +1,177 @@
+#pragma once
+
+#include "platform/platform.h"
+
+/** I2C slave register file.
+
+    Exposes a packed struct T as a set of 8bit registers to an I2C master. Every transaction starts with the master writing the register index, followed either by data bytes to be written to consecutive registers, or by a repeated start and reading consecutive registers. Only the first WRITABLE bytes of T can be written by the master, the rest are read only.
+
+    The firmware learns which registers the master wrote from the mask fetch() returns, so that it applies only those and a write of a single register does not bring back stale values of the others.
+
+    Multi-byte accesses are atomic. Writes are staged and only committed to the registers when the master sends the stop condition, so the firmware never sees half of a 16bit value. Reads are served from a snapshot taken when the master addresses the device for reading, so the firmware updating the registers mid-transaction does not tear them either.
+
+    All storage is static and every interrupt does a bounded amount of work (the snapshot at the start of a read being the largest at sizeof(T) bytes), so that many lights can be polled on one bus without affecting their timing.
+
+    The bus events are handled by the platform independent onAddress(), onStop(), onRead() and onWrite() methods, which are called from the TWI slave interrupt on the megaTinyCore and can be called directly by the mock platform.
+ */
+template<typename T, uint8_t WRITABLE = sizeof(T)>
+class I2CRegisters {
+public:
+
+    static_assert(sizeof(T) < 255, "Register file too large");
+    static_assert(WRITABLE <= sizeof(T), "More writable registers than the register file has");
+    static_assert(WRITABLE <= 8, "The written registers are tracked in a single byte mask");
+
+    /** Bits of the registers from index to index + size - 1 in the mask returned by fetch(), e.g. mask(offsetof(T, field), sizeof(T::field)).
+     */
+    static constexpr uint8_t mask(uint8_t index, uint8_t size = 1) {
+        return static_cast<uint8_t>(((1 << size) - 1) << index);
+    }
+
+    static void initialize(uint8_t address, bool alternatePins = false) {
+        index_ = 0;
+        written_ = 0;
+        i2c::initializeSlave(address, alternatePins);
+    }
+
+    /** If the master has written any registers since the last call, copies all registers to the given value and returns the mask of the registers written, bit i being set for register i. Returns 0 otherwise.
+
+        The registers not written hold what was last published, which the firmware may have changed since.
+     */
+    static uint8_t fetch(T & into) {
+        uint8_t result;
+        cli();
+        result = written_;
+        if (result != 0) {
+            copy(reinterpret_cast<uint8_t *>(& into), registers_, sizeof(T));
+            written_ = 0;
+        }
+        sei();
+        return result;
+    }
+
+    /** Returns true if the master has written registers that have not yet been fetched. 
+     */
+    static bool pending() {
+        return written_ != 0;
+    }
+
+    /** Updates the register file with the firmware's state.
+
+        The registers the master has written and that have not yet been fetched are kept, so that the master's changes are not lost.
+     */
+    static void publish(T const & from) {
+        uint8_t const * values = reinterpret_cast<uint8_t const *>(& from);
+        cli();
+        for (uint8_t i = 0; i < WRITABLE; ++i)
+            if (! (written_ & mask(i)))
+                registers_[i] = values[i];
+        copy(registers_ + WRITABLE, values + WRITABLE, sizeof(T) - WRITABLE);
+        sei();
+    }
+
+    /** Address match. 
+     
+        A repeated start ends any previous write just like the stop condition would. 
+     */
+    static void onAddress(bool read) {
+        onStop();
+        if (read)
+            copy(snapshot_, registers_, sizeof(T));
+        else
+            expectIndex_ = true;
+    }
+
+    /** Stop condition. Commits any staged writes to the registers.
+     */
+    static void onStop() {
+        if (stageEnd_ > stageStart_) {
+            copy(registers_ + stageStart_, stage_ + stageStart_, stageEnd_ - stageStart_);
+            written_ |= mask(stageStart_, stageEnd_ - stageStart_);
+        }
+        stageStart_ = stageEnd_;
+    }
+
+    /** Master reads a byte. Registers past the end of the file read as 0xff.
+     */
+    static uint8_t onRead() {
+        uint8_t result = (index_ < sizeof(T)) ? snapshot_[index_] : 0xff;
+        ++index_;
+        return result;
+    }
+
+    /** Master writes a byte. Returns true if the byte should be acknowledged, which it is not when writing past the writable registers.
+     */
+    static bool onWrite(uint8_t value) {
+        if (expectIndex_) {
+            expectIndex_ = false;
+            index_ = value;
+            stageStart_ = value;
+            stageEnd_ = value;
+            return true;
+        }
+        if (index_ >= WRITABLE)
+            return false;
+        stage_[index_++] = value;
+        stageEnd_ = index_;
+        return true;
+    }
+
+#if (defined ARCH_AVR_MEGATINY)
+    /** The TWI slave interrupt handler. Must be called from the TWI0_TWIS_vect.
+     */
+    static void interrupt() {
+        uint8_t status = TWI0.SSTATUS;
+        if (status & TWI_APIF_bm) {
+            if (status & TWI_AP_bm) {
+                txStarted_ = false;
+                onAddress(status & TWI_DIR_bm);
+                TWI0.SCTRLB = TWI_SCMD_RESPONSE_gc;
+            } else {
+                onStop();
+                TWI0.SCTRLB = TWI_SCMD_COMPTRANS_gc;
+            }
+        } else if (status & TWI_DIF_bm) {
+            if (status & TWI_DIR_bm) {
+                // master read, finish if the master did not acknowledge the last byte we sent
+                if (txStarted_ && (status & TWI_RXACK_bm)) {
+                    TWI0.SCTRLB = TWI_SCMD_COMPTRANS_gc;
+                } else {
+                    txStarted_ = true;
+                    TWI0.SDATA = onRead();
+                    TWI0.SCTRLB = TWI_SCMD_RESPONSE_gc;
+                }
+            } else {
+                TWI0.SCTRLB = onWrite(TWI0.SDATA) ? TWI_SCMD_RESPONSE_gc : (TWI_ACKACT_NACK_gc | TWI_SCMD_RESPONSE_gc);
+            }
+        }
+    }
+#endif
+
+private:
+
+    static void copy(uint8_t volatile * to, uint8_t const volatile * from, uint8_t size) {
+        while (size-- > 0)
+            *(to++) = *(from++);
+    }
+
+    static inline volatile uint8_t registers_[sizeof(T)];
+    static inline volatile uint8_t snapshot_[sizeof(T)];
+    static inline volatile uint8_t stage_[WRITABLE == 0 ? 1 : WRITABLE];
+    static inline volatile uint8_t index_ = 0;
+    static inline volatile uint8_t stageStart_ = 0;
+    static inline volatile uint8_t stageEnd_ = 0;
+    static inline volatile bool expectIndex_ = false;
+    static inline volatile bool txStarted_ = false;
+    // mask of the registers written and not yet fetched
+    static inline volatile uint8_t written_ = 0;
+
+}; // I2CRegisters
+
+/** Declares the TWI slave interrupt for the given register file. Must be used in exactly one translation unit.
+ */
+#if (defined ARCH_AVR_MEGATINY)
+#define I2C_REGISTERS_ISR(...) ISR(TWI0_TWIS_vect) { __VA_ARGS__::interrupt(); }
+#else
+#define I2C_REGISTERS_ISR(...)
+#endif
@@ -0,0 +1,48 @@
+#pragma once
+
+#include "utils/color.h"
+
+/** Predefined palettes. 
+ 
+    Each palette is 16 r, g, b stops in flash (48 bytes), only the palettes actually used end up in the firmware. 
+ */
+
+/** Black through red, orange and yellow to white, a gradient for heat values. 
+ */
+constexpr uint8_t FIRE_STOPS[] PROGMEM = {
+    0x00, 0x00, 0x00,   0x20, 0x00, 0x00,   0x40, 0x00, 0x00,   0x60, 0x00, 0x00,
+    0x80, 0x00, 0x00,   0xa0, 0x08, 0x00,   0xc0, 0x10, 0x00,   0xe0, 0x20, 0x00,
+    0xff, 0x30, 0x00,   0xff, 0x48, 0x00,   0xff, 0x60, 0x00,   0xff, 0x80, 0x00,
+    0xff, 0xa0, 0x00,   0xff, 0xc0, 0x10,   0xff, 0xe0, 0x60,   0xff, 0xff, 0xc0,
+};
+constexpr Palette FIRE_PALETTE{FIRE_STOPS, false};
+
+/** Deep blue through purple and pink to a warm orange glow, and back. 
+ */
+constexpr uint8_t DUSK_STOPS[] PROGMEM = {
+    0x08, 0x00, 0x30,   0x10, 0x00, 0x50,   0x28, 0x00, 0x68,   0x48, 0x00, 0x78,
+    0x70, 0x00, 0x70,   0x98, 0x08, 0x60,   0xc0, 0x10, 0x48,   0xe0, 0x28, 0x30,
+    0xff, 0x50, 0x10,   0xff, 0x70, 0x00,   0xe0, 0x40, 0x10,   0xb0, 0x18, 0x30,
+    0x80, 0x00, 0x50,   0x50, 0x00, 0x60,   0x28, 0x00, 0x58,   0x10, 0x00, 0x40,
+};
+constexpr Palette DUSK_PALETTE{DUSK_STOPS};
+
+/** Blues, teals and greens of light under water. 
+ */
+constexpr uint8_t UNDERWATER_STOPS[] PROGMEM = {
+    0x00, 0x00, 0x30,   0x00, 0x00, 0x60,   0x00, 0x10, 0x90,   0x00, 0x30, 0xb0,
+    0x00, 0x60, 0xc0,   0x00, 0x90, 0xb0,   0x10, 0xb0, 0x90,   0x20, 0xc0, 0x70,
+    0x10, 0x90, 0x80,   0x00, 0x70, 0xa0,   0x00, 0x50, 0xc0,   0x20, 0x80, 0xff,
+    0x40, 0xa0, 0xff,   0x00, 0x60, 0xc0,   0x00, 0x30, 0x90,   0x00, 0x10, 0x60,
+};
+constexpr Palette UNDERWATER_PALETTE{UNDERWATER_STOPS};
+
+/** The HSV color wheel, for rainbows that can share code with other palettes. 
+ */
+constexpr uint8_t RAINBOW_STOPS[] PROGMEM = {
+    0xff, 0x00, 0x00,   0xff, 0x60, 0x00,   0xff, 0xc0, 0x00,   0xdf, 0xff, 0x00,
+    0x80, 0xff, 0x00,   0x20, 0xff, 0x00,   0x00, 0xff, 0x40,   0x00, 0xff, 0xa0,
+    0x00, 0xff, 0xff,   0x00, 0xa0, 0xff,   0x00, 0x40, 0xff,   0x20, 0x00, 0xff,
+    0x80, 0x00, 0xff,   0xdf, 0x00, 0xff,   0xff, 0x00, 0xc0,   0xff, 0x00, 0x60,
+};
+constexpr Palette RAINBOW_PALETTE{RAINBOW_STOPS};
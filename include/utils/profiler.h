@@ -0,0 +1,185 @@
+#pragma once
+
+#include "platform/platform.h"
+
+/** Section profiler.
+
+    Measures how long named sections of the firmware take. The sections are identified by small integer ids (an enum of the firmware) and marked by PROFILE_SCOPE(section, budget), which covers the rest of the enclosing block. There are two modes, selected by build flags:
+
+    PROFILE keeps the minimum, maximum and average duration in cycles, and the number of runs over the budget (in cycles) of each section in a static table. The time is taken from TCB0 free running at half the CPU clock, so the resolution is 2 cycles and sections longer than 131072 cycles (16ms at 8MHz) wrap around. The durations and budgets are kept in 32 bits, as a whole tick is longer than 65535 cycles. Entering and leaving a section costs a few dozen cycles. The table is read by PROFILE_REPORT(fn), which calls fn(section, stats) for every section and resets the stats of the sections fn returns true for, so that a report that could not be delivered is not lost but covers a longer period the next time.
+
+    PROFILE_TRACE instead toggles PB3 (pin 4, unused by the light) on entry and exit of the section whose id it is defined to, for a logic analyzer. The other sections compile to nothing, so that nested sections do not toggle the same pin and the pin is high exactly while the traced section runs. A toggle is a single cycle write to the VPORT, so the trace hardly disturbs the timing it shows.
+
+    Without either flag the macros expand to nothing, so the profiler compiles away completely.
+ */
+
+#if (defined PROFILE)
+
+template<uint8_t SECTIONS>
+class Profiler {
+public:
+
+    struct Stats {
+        uint32_t min;
+        uint32_t max;
+        uint32_t total;
+        uint16_t count;
+        uint16_t overruns;
+
+        uint32_t avg() const {
+            return count == 0 ? 0 : total / count;
+        }
+    };
+
+    /** Starts TCB0 counting at half the CPU clock.
+     */
+    static void initialize() {
+#if (defined MILLIS_USE_TIMERB0)
+        #error "The profiler needs TCB0, which is used for millis"
+#endif
+#if (defined ARCH_AVR_MEGATINY)
+        TCB0.CTRLA = 0;
+        TCB0.CTRLB = TCB_CNTMODE_INT_gc;
+        TCB0.CCMP = 0xffff;
+        TCB0.CNT = 0;
+        TCB0.CTRLA = TCB_CLKSEL_CLKDIV2_gc | TCB_ENABLE_bm;
+#endif
+        reset();
+    }
+
+    static void reset() {
+        for (uint8_t i = 0; i < SECTIONS; ++i)
+            reset(i);
+    }
+
+    static void reset(uint8_t section) {
+        Stats & s = stats_[section];
+        s.min = 0xffffffff;
+        s.max = 0;
+        s.total = 0;
+        s.count = 0;
+        s.overruns = 0;
+    }
+
+    static uint16_t now() {
+#if (defined ARCH_AVR_MEGATINY)
+        return TCB0.CNT;
+#else
+        return 0;
+#endif
+    }
+
+    /** Records a run of the section that started at the given time.
+     */
+    static void record(uint8_t section, uint16_t start, uint32_t budget) {
+        // 16bit arithmetics handles the counter wrapping around, the cycles do not fit 16 bits
+        uint32_t cycles = static_cast<uint32_t>(static_cast<uint16_t>(now() - start)) * 2;
+        Stats & s = stats_[section];
+        if (cycles < s.min)
+            s.min = cycles;
+        if (cycles > s.max)
+            s.max = cycles;
+        if (cycles > budget)
+            ++s.overruns;
+        // avoid the average overflowing, it only needs to cover the reporting period
+        if (s.count < 0xffff && s.total <= 0xffffffff - cycles) {
+            s.total += cycles;
+            ++s.count;
+        }
+    }
+
+    /** Calls fn(section, stats) for every section that ran since the last report and resets the stats of the section if fn returns true, i.e. if it delivered them.
+     */
+    template<typename F>
+    static void report(F fn) {
+        for (uint8_t i = 0; i < SECTIONS; ++i)
+            if (stats_[i].count > 0 && fn(i, stats_[i]))
+                reset(i);
+    }
+
+    /** Measures the enclosing scope.
+     */
+    class Scope {
+    public:
+        Scope(uint8_t section, uint32_t budget):
+            start_{now()},
+            section_{section},
+            budget_{budget} {
+        }
+
+        ~Scope() {
+            record(section_, start_, budget_);
+        }
+
+    private:
+        uint16_t start_;
+        uint8_t section_;
+        uint32_t budget_;
+    }; // Profiler::Scope
+
+private:
+
+    static inline Stats stats_[SECTIONS];
+
+}; // Profiler
+
+#define PROFILE_CONCAT_(A, B) A ## B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_(A, B)
+
+/** Declares the profiler for given number of sections, must be used once before any other PROFILE_ macro.
+ */
+#define PROFILE_SECTIONS(COUNT) using SectionProfiler = Profiler<COUNT>;
+#define PROFILE_INITIALIZE() SectionProfiler::initialize()
+#define PROFILE_SCOPE(SECTION, BUDGET) SectionProfiler::Scope PROFILE_CONCAT(profileScope_, __LINE__){static_cast<uint8_t>(SECTION), BUDGET}
+#define PROFILE_REPORT(FN) SectionProfiler::report(FN)
+
+#elif (defined PROFILE_TRACE)
+
+/** Toggles the trace pin when the enclosing scope is entered and left, if it is the traced section.
+ */
+template<uint8_t SECTION>
+class ProfileTrace {
+public:
+
+    static void initialize() {
+#if (defined ARCH_AVR_MEGATINY)
+        VPORTB.DIR |= PIN3_bm;
+        VPORTB.OUT &= ~PIN3_bm;
+#endif
+    }
+
+    static void toggle() {
+#if (defined ARCH_AVR_MEGATINY)
+        // writing one to the input register toggles the output
+        VPORTB.IN = PIN3_bm;
+#endif
+    }
+
+    ProfileTrace() {
+        if (SECTION == PROFILE_TRACE)
+            toggle();
+    }
+
+    ~ProfileTrace() {
+        if (SECTION == PROFILE_TRACE)
+            toggle();
+    }
+
+}; // ProfileTrace
+
+#define PROFILE_CONCAT_(A, B) A ## B
+#define PROFILE_CONCAT(A, B) PROFILE_CONCAT_(A, B)
+
+#define PROFILE_SECTIONS(COUNT)
+#define PROFILE_INITIALIZE() ProfileTrace<PROFILE_TRACE>::initialize()
+#define PROFILE_SCOPE(SECTION, BUDGET) ProfileTrace<static_cast<uint8_t>(SECTION)> PROFILE_CONCAT(profileTrace_, __LINE__)
+#define PROFILE_REPORT(FN)
+
+#else
+
+#define PROFILE_SECTIONS(COUNT)
+#define PROFILE_INITIALIZE()
+#define PROFILE_SCOPE(SECTION, BUDGET)
+#define PROFILE_REPORT(FN)
+
+#endif
@@ -0,0 +1,65 @@
+#pragma once
+
+#include "platform/platform.h"
+
+/** Single producer, single consumer ring buffer of bytes.
+
+    The producer only moves the head and the consumer only moves the tail, so one side can be an interrupt handler and the other the main loop without disabling interrupts. SIZE must be a power of two, one byte is kept free to tell a full buffer from an empty one.
+ */
+template<uint8_t SIZE>
+class RingBuffer {
+public:
+
+    static_assert(SIZE >= 2 && (SIZE & (SIZE - 1)) == 0, "Ring buffer size must be a power of two");
+
+    bool empty() const {
+        return head_ == tail_;
+    }
+
+    /** Number of bytes in the buffer.
+     */
+    uint8_t size() const {
+        return (head_ - tail_) & MASK;
+    }
+
+    /** Number of bytes that can be pushed.
+     */
+    uint8_t free() const {
+        return SIZE - 1 - size();
+    }
+
+    /** Appends the byte, returns false if the buffer is full.
+     */
+    bool push(uint8_t value) {
+        uint8_t next = (head_ + 1) & MASK;
+        if (next == tail_)
+            return false;
+        data_[head_] = value;
+        head_ = next;
+        return true;
+    }
+
+    /** Removes the oldest byte, returns false if the buffer is empty.
+     */
+    bool pop(uint8_t & value) {
+        uint8_t tail = tail_;
+        if (head_ == tail)
+            return false;
+        value = data_[tail];
+        tail_ = (tail + 1) & MASK;
+        return true;
+    }
+
+    void clear() {
+        tail_ = head_;
+    }
+
+private:
+
+    static constexpr uint8_t MASK = SIZE - 1;
+
+    volatile uint8_t data_[SIZE];
+    volatile uint8_t head_ = 0;
+    volatile uint8_t tail_ = 0;
+
+}; // RingBuffer
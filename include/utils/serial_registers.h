@@ -0,0 +1,229 @@
+#pragma once
+
+#include "platform/platform.h"
+#include "utils/ring_buffer.h"
+
+/** Serial register file.
+
+    Exposes a packed struct T over the USART with the same interface as I2CRegisters, so that the firmware can be driven by either. Only the first WRITABLE bytes of T can be written by the host, the rest are read only. Data travels in frames:
+
+        SYNC (0xa5), type, length, payload (up to MAX_PAYLOAD bytes), CRC-8 of the type, length and payload
+
+    The host sends
+
+        WRITE       index, bytes    writes the bytes to consecutive registers, starting at index
+        TELEMETRY   period          sends the registers every period publish() calls, 0 stops
+        READ                        sends the registers once, with the next publish()
+
+    and the light sends REGISTERS frames with all the registers, and any frames the firmware sends itself, e.g. profiler stats. Frames with a bad checksum, or writes past the writable registers are ignored.
+
+    The interrupts only move bytes between the USART and two static ring buffers. The received frames are parsed by fetch() in the main loop, which handles no more bytes than have been received, and frames to be sent are dropped whole when the transmit buffer is full. Nothing ever waits for the wire, so the tick is never blocked.
+
+    Like with I2CRegisters, fetch() returns the mask of the registers the host wrote, so that the firmware applies only those.
+
+    The interrupts call the platform independent onReceive() and onTransmit() methods, which can be called directly by the mock platform.
+ */
+template<typename T, uint8_t WRITABLE = sizeof(T)>
+class SerialRegisters {
+public:
+
+    static constexpr uint8_t SYNC = 0xa5;
+    static constexpr uint8_t MAX_PAYLOAD = 32;
+
+    static constexpr uint8_t WRITE = 0x01;
+    static constexpr uint8_t TELEMETRY = 0x02;
+    static constexpr uint8_t READ = 0x03;
+    static constexpr uint8_t REGISTERS = 0x81;
+
+    static_assert(sizeof(T) <= MAX_PAYLOAD, "Register file too large");
+    static_assert(WRITABLE <= sizeof(T), "More writable registers than the register file has");
+    static_assert(WRITABLE <= 8, "The written registers are tracked in a single byte mask");
+
+    /** Bits of the registers from index to index + size - 1 in the mask returned by fetch(), e.g. mask(offsetof(T, field), sizeof(T::field)).
+     */
+    static constexpr uint8_t mask(uint8_t index, uint8_t size = 1) {
+        return static_cast<uint8_t>(((1 << size) - 1) << index);
+    }
+
+    static void initialize(uint32_t baudrate, bool alternatePins = false) {
+        parser_ = Parser::Sync;
+        written_ = 0;
+        read_ = false;
+        period_ = 0;
+        uart::initialize(baudrate, alternatePins);
+    }
+
+    /** Handles the received frames. If the host has written any registers since the last call, copies all registers to the given value and returns the mask of the registers written, bit i being set for register i. Returns 0 otherwise.
+
+        The registers not written hold what was last published, which the firmware may have changed since.
+     */
+    static uint8_t fetch(T & into) {
+        uint8_t value;
+        while (rx_.pop(value))
+            parse(value);
+        uint8_t result = written_;
+        if (result != 0) {
+            memcpy(& into, registers_, sizeof(T));
+            written_ = 0;
+        }
+        return result;
+    }
+
+    /** Returns true if the host has written registers that have not yet been fetched, or if there are received bytes not yet handled.
+     */
+    static bool pending() {
+        return written_ != 0 || ! rx_.empty();
+    }
+
+    /** Updates the register file with the firmware's state and sends it if the telemetry is due, or the host asked for it.
+
+        The registers the host has written and that have not yet been fetched are kept, so that the host's changes are not lost.
+     */
+    static void publish(T const & from) {
+        uint8_t const * values = reinterpret_cast<uint8_t const *>(& from);
+        for (uint8_t i = 0; i < WRITABLE; ++i)
+            if (! (written_ & mask(i)))
+                registers_[i] = values[i];
+        memcpy(registers_ + WRITABLE, values + WRITABLE, sizeof(T) - WRITABLE);
+        if (period_ != 0 && --countdown_ == 0) {
+            countdown_ = period_;
+            read_ = true;
+        }
+        if (read_ && send(REGISTERS, registers_, sizeof(T)))
+            read_ = false;
+    }
+
+    /** Queues a frame of given type to be sent. Returns false, sending nothing, if the frame does not fit in the transmit buffer.
+     */
+    static bool send(uint8_t type, void const * payload, uint8_t size) {
+        if (size > MAX_PAYLOAD || tx_.free() < size + 4)
+            return false;
+        uint8_t const * data = static_cast<uint8_t const *>(payload);
+        uint8_t header[] = { type, size };
+        uint8_t crc = CRC8(data, size, CRC8(header, 2));
+        tx_.push(SYNC);
+        tx_.push(type);
+        tx_.push(size);
+        for (uint8_t i = 0; i < size; ++i)
+            tx_.push(data[i]);
+        tx_.push(crc);
+        uart::startTransmit();
+        return true;
+    }
+
+    /** Byte received. Dropped if the receive buffer is full.
+     */
+    static void onReceive(uint8_t value) {
+        rx_.push(value);
+    }
+
+    /** Next byte to transmit, returns false if there is none.
+     */
+    static bool onTransmit(uint8_t & value) {
+        return tx_.pop(value);
+    }
+
+#if (defined ARCH_AVR_MEGATINY)
+    /** The USART receive complete interrupt handler. Must be called from USART0_RXC_vect.
+     */
+    static void receiveInterrupt() {
+        onReceive(USART0.RXDATAL);
+    }
+
+    /** The USART data register empty interrupt handler. Must be called from USART0_DRE_vect.
+     */
+    static void transmitInterrupt() {
+        uint8_t value;
+        if (onTransmit(value))
+            USART0.TXDATAL = value;
+        else
+            USART0.CTRLA &= ~USART_DREIE_bm;
+    }
+#endif
+
+private:
+
+    enum class Parser : uint8_t {
+        Sync,
+        Type,
+        Length,
+        Payload,
+        Crc,
+    };
+
+    static void parse(uint8_t value) {
+        switch (parser_) {
+            case Parser::Sync:
+                if (value == SYNC)
+                    parser_ = Parser::Type;
+                break;
+            case Parser::Type:
+                frame_[0] = value;
+                parser_ = Parser::Length;
+                break;
+            case Parser::Length:
+                frame_[1] = value;
+                received_ = 0;
+                parser_ = value > MAX_PAYLOAD ? Parser::Sync : value == 0 ? Parser::Crc : Parser::Payload;
+                break;
+            case Parser::Payload:
+                frame_[2 + received_++] = value;
+                if (received_ == frame_[1])
+                    parser_ = Parser::Crc;
+                break;
+            case Parser::Crc:
+                if (value == CRC8(frame_, 2 + frame_[1]))
+                    handle(frame_[0], frame_ + 2, frame_[1]);
+                parser_ = Parser::Sync;
+                break;
+        }
+    }
+
+    static void handle(uint8_t type, uint8_t const * payload, uint8_t size) {
+        switch (type) {
+            case WRITE:
+                if (size < 2 || payload[0] + size - 1 > WRITABLE)
+                    break;
+                memcpy(registers_ + payload[0], payload + 1, size - 1);
+                written_ |= mask(payload[0], size - 1);
+                break;
+            case TELEMETRY:
+                if (size == 1) {
+                    period_ = payload[0];
+                    countdown_ = period_;
+                }
+                break;
+            case READ:
+                read_ = true;
+                break;
+            default:
+                break;
+        }
+    }
+
+    static inline RingBuffer<32> rx_;
+    static inline RingBuffer<64> tx_;
+
+    static inline Parser parser_ = Parser::Sync;
+    // type, length and payload of the frame being received
+    static inline uint8_t frame_[2 + MAX_PAYLOAD];
+    static inline uint8_t received_ = 0;
+
+    static inline uint8_t registers_[sizeof(T)];
+    // mask of the registers written and not yet fetched
+    static inline uint8_t written_ = 0;
+    static inline bool read_ = false;
+    static inline uint8_t period_ = 0;
+    static inline uint8_t countdown_ = 0;
+
+}; // SerialRegisters
+
+/** Declares the USART interrupts for the given register file. Must be used in exactly one translation unit.
+ */
+#if (defined ARCH_AVR_MEGATINY)
+#define SERIAL_REGISTERS_ISR(...) \
+    ISR(USART0_RXC_vect) { __VA_ARGS__::receiveInterrupt(); } \
+    ISR(USART0_DRE_vect) { __VA_ARGS__::transmitInterrupt(); }
+#else
+#define SERIAL_REGISTERS_ISR(...)
+#endif
@@ -0,0 +1,111 @@
+#pragma once
+
+#include "platform/platform.h"
+
+/** Wear leveled settings store in EEPROM.
+
+    The settings (a trivially copyable struct T) are stored in a ring of SLOTS records starting at OFFSET, each record consisting of a sequence number, the settings and a CRC. New settings are always written to the slot after the newest one, so that every slot wears equally. The CRC is salted with VERSION so that records written by a firmware with a different settings layout are ignored.
+
+    Writes are deferred. Updated settings are only committed when they have not changed for DELAY ticks, or when flush() is called (before sleep), so that repeated button presses result in a single write.
+
+    Restore only reads the sequence numbers to find the newest record and then checksums it, so takes microseconds. If the newest record is damaged (power lost mid write), the previous one is used.
+ */
+template<typename T, uint8_t SLOTS, uint16_t DELAY, uint16_t OFFSET = 0, uint8_t VERSION = 1>
+class SettingsStore {
+public:
+
+    static constexpr uint8_t RECORD_SIZE = sizeof(T) + 2;
+
+    static_assert(SLOTS > 1 && SLOTS < 128, "Invalid number of slots");
+    static_assert(sizeof(T) < 254, "Settings too large");
+
+    /** Restores the newest valid settings. Returns false and leaves the argument intact if there are none.
+     */
+    bool restore(T & into) {
+        // the newest record is the one after which the sequence numbers stop incrementing
+        head_ = SLOTS - 1;
+        uint8_t seq = eeprom::read(address(0));
+        for (uint8_t i = 0; i < SLOTS - 1; ++i) {
+            uint8_t next = eeprom::read(address(i + 1));
+            if (next != static_cast<uint8_t>(seq + 1)) {
+                head_ = i;
+                break;
+            }
+            seq = next;
+        }
+        // find the newest record that is not damaged
+        for (uint8_t i = 0; i < SLOTS; ++i) {
+            uint8_t slot = (head_ + SLOTS - i) % SLOTS;
+            uint8_t record[RECORD_SIZE];
+            eeprom::read(address(slot), record, RECORD_SIZE);
+            if (CRC8(record, RECORD_SIZE - 1, VERSION) == record[RECORD_SIZE - 1]) {
+                head_ = slot;
+                seq_ = record[0];
+                memcpy(& committed_, record + 1, sizeof(T));
+                pending_ = committed_;
+                dirty_ = false;
+                into = committed_;
+                return true;
+            }
+        }
+        // nothing valid, continue the sequence after the head so that the next record becomes the newest
+        seq_ = eeprom::read(address(head_));
+        committed_ = into;
+        pending_ = into;
+        dirty_ = false;
+        return false;
+    }
+
+    /** Updates the settings.
+
+        The settings will be committed once they stay unchanged for DELAY ticks.
+     */
+    void update(T const & value) {
+        if (memcmp(& value, & pending_, sizeof(T)) != 0) {
+            pending_ = value;
+            countdown_ = DELAY;
+            dirty_ = memcmp(& pending_, & committed_, sizeof(T)) != 0;
+        }
+    }
+
+    /** Counts down the stable period and commits the settings when it elapses.
+     */
+    void tick() {
+        if (dirty_ && --countdown_ == 0)
+            commit();
+    }
+
+    /** Commits any pending settings immediately and waits for the write to finish.
+     */
+    void flush() {
+        if (dirty_)
+            commit();
+        eeprom::wait();
+    }
+
+private:
+
+    static constexpr uint16_t address(uint8_t slot) {
+        return OFFSET + slot * RECORD_SIZE;
+    }
+
+    void commit() {
+        head_ = (head_ + 1) % SLOTS;
+        uint8_t record[RECORD_SIZE];
+        record[0] = ++seq_;
+        memcpy(record + 1, & pending_, sizeof(T));
+        record[RECORD_SIZE - 1] = CRC8(record, RECORD_SIZE - 1, VERSION);
+        eeprom::write(address(head_), record, RECORD_SIZE);
+        committed_ = pending_;
+        dirty_ = false;
+    }
+
+    T committed_;
+    T pending_;
+    uint16_t countdown_ = 0;
+    // the slot of the newest record and its sequence number
+    uint8_t head_ = SLOTS - 1;
+    uint8_t seq_ = 0xff;
+    bool dirty_ = false;
+
+}; // SettingsStore
@@ -0,0 +1,134 @@
+#pragma once
+
+#include "platform/platform.h"
+#include "utils/ring_buffer.h"
+
+/** Effect timebase shared by several lights.
+
+    Every light counts its ticks in a timebase that wraps around after PERIOD ticks, and the effects derive their phase from it (e.g. the rainbow's hue, the candle's flicker from noise() and the ticks the effects update on) instead of free running, so lights with the same timebase show the same animation. One light is the LEADER, which sends its timebase as a beacon every BEACON_TICKS ticks on the sync wire (see syncwire of the platform), the others follow:
+
+        SYNC (0x5a), timebase (16 bit, little endian), CRC-8 of the timebase
+
+    The leader sends the beacon at the start of its tick, the follower waits for it in wait() instead of the tick's delay, so that its next tick starts right after the beacon with the leader's timebase. The followers are thus phase locked to the leader within the beacon's length (~1ms at 38400 baud) at every beacon and drift apart only by the difference of their clocks and tick lengths till the next one (0.25s by default, i.e. 2.5ms for 1% difference). A follower without a leader simply runs its own timebase.
+
+    The beacon costs the leader its 4 bytes of interrupts disabled every BEACON_TICKS (0.4% of its time by default), the followers a receive interrupt per byte. A lost beacon only delays the correction till the next one.
+ */
+template<bool LEADER, uint16_t PERIOD, uint8_t BEACON_TICKS>
+class SyncClock {
+public:
+
+    static constexpr uint8_t SYNC = 0x5a;
+
+    static void initialize() {
+        if (LEADER)
+            syncwire::initializeTransmitter();
+        else
+            syncwire::initializeReceiver();
+    }
+
+    /** The current tick of the timebase, from 0 to PERIOD - 1.
+     */
+    static uint16_t ticks() {
+        return ticks_;
+    }
+
+    /** Pseudo random byte of given tick of the timebase, the same on all lights.
+     */
+    static uint8_t noise(uint16_t ticks) {
+        uint16_t x = ticks * 0x9e37;
+        x ^= x >> 8;
+        x *= 0x9e37;
+        return static_cast<uint8_t>(x >> 8);
+    }
+
+    /** Advances the timebase by one tick.
+
+        The leader sends the beacon when due, the follower takes the timebase of the beacon received since the last tick, if any. Returns true in both cases, i.e. whenever the effects should be aligned to the timebase.
+     */
+    static bool tick() {
+        if (++ticks_ == PERIOD)
+            ticks_ = 0;
+        if (LEADER) {
+            if (++countdown_ < BEACON_TICKS)
+                return false;
+            countdown_ = 0;
+            uint8_t beacon[] = { SYNC, static_cast<uint8_t>(ticks_ & 0xff), static_cast<uint8_t>(ticks_ >> 8), 0 };
+            beacon[3] = CRC8(beacon + 1, 2);
+            syncwire::send(beacon, sizeof(beacon));
+            return true;
+        } else {
+            poll();
+            if (! received_)
+                return false;
+            received_ = false;
+            ticks_ = beacon_;
+            return true;
+        }
+    }
+
+    /** Waits for the given milliseconds, the delay of the tick. A follower stops waiting as soon as a beacon is received, so that its next tick starts with the leader's.
+     */
+    static void wait(uint8_t ms) {
+        if (LEADER) {
+            cpu::delay_ms(ms);
+            return;
+        }
+        for (uint16_t i = static_cast<uint16_t>(ms) * 10; i > 0 && ! poll(); --i)
+            cpu::delay_us(100);
+    }
+
+    /** Byte received from the sync wire. Dropped if the receive buffer is full.
+     */
+    static void onReceive(uint8_t value) {
+        rx_.push(value);
+    }
+
+#if (defined ARCH_AVR_MEGATINY)
+    /** The USART receive complete interrupt handler. Must be called from USART0_RXC_vect.
+     */
+    static void receiveInterrupt() {
+        onReceive(USART0.RXDATAL);
+    }
+#endif
+
+private:
+
+    /** Parses the received bytes, returns true if a beacon is waiting to be taken by tick().
+     */
+    static bool poll() {
+        uint8_t value;
+        while (rx_.pop(value)) {
+            if (length_ == 0 && value != SYNC)
+                continue;
+            frame_[length_++] = value;
+            if (length_ < sizeof(frame_))
+                continue;
+            length_ = 0;
+            uint16_t ticks = frame_[1] | static_cast<uint16_t>(frame_[2]) << 8;
+            if (frame_[0] == SYNC && frame_[3] == CRC8(frame_ + 1, 2) && ticks < PERIOD) {
+                beacon_ = ticks;
+                received_ = true;
+            }
+        }
+        return received_;
+    }
+
+    static inline uint16_t ticks_ = 0;
+    static inline uint8_t countdown_ = 0;
+
+    static inline RingBuffer<8> rx_;
+    static inline uint8_t frame_[4];
+    static inline uint8_t length_ = 0;
+    // timebase of the last beacon, taken by the next tick
+    static inline uint16_t beacon_;
+    static inline bool received_ = false;
+
+}; // SyncClock
+
+/** Declares the USART receive interrupt of a following clock. Must be used in exactly one translation unit.
+ */
+#if (defined ARCH_AVR_MEGATINY)
+#define SYNC_CLOCK_ISR(...) ISR(USART0_RXC_vect) { __VA_ARGS__::receiveInterrupt(); }
+#else
+#define SYNC_CLOCK_ISR(...)
+#endif
@@ -0,0 +1,64 @@
+#pragma once
+
+#include "platform/platform.h"
+
+/** Thermal derating of the outputs.
+
+    Samples the temperature of the chip (see adc::readTemperature()) every PERIOD ticks, so that the ADC is off almost all the time, and filters the samples with an exponential moving average of 2^SHIFT samples in fixed point. The filter keeps the average shifted left by SHIFT, so that the shifts lose no precision, and follows the slow heating of the case rather than the noise of the sensor. The first sample starts the average.
+
+    The filtered temperature is mapped to the maximum output by a linear derating curve: full output (255) up to START_C, falling to MIN at END_C and MIN above it. 
+ */
+template<uint8_t PERIOD, int8_t START_C, int8_t END_C, uint8_t MIN, uint8_t SHIFT = 3>
+class ThermalLimiter {
+public:
+
+    static_assert(START_C < END_C, "Derating must end above where it starts");
+
+    /** Advances by one tick, sampling the temperature when due. Returns true if the limit changed.
+     */
+    bool tick() {
+        if (--countdown_ != 0)
+            return false;
+        countdown_ = PERIOD;
+        uint16_t sample = adc::readTemperature();
+        if (sum_ == 0)
+            sum_ = static_cast<uint32_t>(sample) << SHIFT;
+        else
+            sum_ = sum_ - (sum_ >> SHIFT) + sample;
+        uint8_t limit = derate(temperature());
+        if (limit == limit_)
+            return false;
+        limit_ = limit;
+        return true;
+    }
+
+    /** The filtered temperature in 1/16 K, 0 before the first sample.
+     */
+    uint16_t temperature() const {
+        return static_cast<uint16_t>(sum_ >> SHIFT);
+    }
+
+    /** The maximum output allowed at the filtered temperature.
+     */
+    uint8_t limit() const {
+        return limit_;
+    }
+
+private:
+
+    static constexpr uint16_t START = (START_C + 273) * 16;
+    static constexpr uint16_t END = (END_C + 273) * 16;
+
+    static uint8_t derate(uint16_t temperature) {
+        if (temperature <= START)
+            return 255;
+        if (temperature >= END)
+            return MIN;
+        return static_cast<uint8_t>(255 - static_cast<uint32_t>(temperature - START) * (255 - MIN) / (END - START));
+    }
+
+    uint8_t countdown_ = 1;
+    uint32_t sum_ = 0;
+    uint8_t limit_ = 255;
+
+}; // ThermalLimiter
@@ -0,0 +1,107 @@
+#pragma once
+
+#include "utils/color.h"
+
+/** Easing curves for transitions.
+ */
+enum class Easing : uint8_t {
+    Linear,
+    // smoothstep, slow start and end
+    EaseInOut,
+    // 2^8 exponential, perceptually even brightness fades
+    Exponential,
+};
+
+/** Timed transition with easing.
+
+    Tracks the progress of a transition that takes a given number of ticks. The position is 8.8 fixed point and advances by a constant step every tick, the only division happens when the transition starts. The eased progress is looked up in a 65 entry curve in flash and interpolated, so every tick costs the same regardless of the distance or the curve. The transition reaches its end exactly after the given number of ticks.
+
+    Does not initialize itself so that the constructor is trivial and the transition can be part of effect states. Static and global transitions are zero initialized, i.e. done.
+ */
+class Transition {
+public:
+
+    Transition() = default;
+
+    void start(uint16_t ticks, Easing easing = Easing::Linear) {
+        easing_ = easing;
+        position_ = 0;
+        remaining_ = ticks;
+        step_ = (ticks == 0) ? 0 : static_cast<uint16_t>(0xffff / ticks);
+    }
+
+    void stop() {
+        remaining_ = 0;
+    }
+
+    bool done() const {
+        return remaining_ == 0;
+    }
+
+    /** Advances the transition by one tick. Returns true if the transition was running.
+     */
+    bool tick() {
+        if (remaining_ == 0)
+            return false;
+        if (--remaining_ == 0)
+            position_ = 0xffff;
+        else
+            position_ += step_;
+        return true;
+    }
+
+    /** Returns the eased progress, from 0 at the start to 256 when done.
+     */
+    uint16_t progress() const {
+        if (remaining_ == 0)
+            return 256;
+        uint8_t index = position_ >> 10;
+        uint8_t frac = (position_ >> 2) & 0xff;
+        uint8_t a;
+        uint8_t b;
+        switch (easing_) {
+            case Easing::EaseInOut:
+                a = pgm_read_byte(easeInOut_ + index);
+                b = pgm_read_byte(easeInOut_ + index + 1);
+                break;
+            case Easing::Exponential:
+                a = pgm_read_byte(exponential_ + index);
+                b = pgm_read_byte(exponential_ + index + 1);
+                break;
+            default:
+                return position_ >> 8;
+        }
+        // the curves are monotonic
+        return a + ((static_cast<uint16_t>(b - a) * frac) >> 8);
+    }
+
+    /** Returns the value between from and to at the current progress.
+     */
+    uint8_t apply(uint8_t from, uint8_t to) const {
+        return Lerp(from, to, progress());
+    }
+
+    Color apply(Color const & from, Color const & to) const {
+        return Color::Blend(from, to, progress());
+    }
+
+private:
+
+    static constexpr uint8_t easeInOut_[65] PROGMEM = {
+        0, 0, 1, 2, 3, 4, 6, 8, 11, 14, 17, 20, 24, 27, 31, 35, 40, 44, 49, 54, 59, 64, 70, 75, 81, 86, 92, 98, 104, 110, 116, 122,
+        128, 133, 139, 145, 151, 157, 163, 169, 174, 180, 185, 191, 196, 201, 206, 211, 215, 220, 224, 228, 231, 235, 238, 241, 244, 247, 249, 251, 252, 253, 254, 255,
+        255,
+    };
+
+    static constexpr uint8_t exponential_[65] PROGMEM = {
+        0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 2, 2, 2, 2, 3, 3, 3, 4, 4, 5, 5, 6, 6, 7, 8, 9, 9, 10, 11, 12, 14,
+        15, 16, 18, 20, 22, 24, 26, 28, 31, 34, 37, 40, 44, 48, 53, 58, 63, 69, 75, 82, 90, 98, 107, 116, 127, 139, 151, 165, 180, 196,
+        214, 234, 255,
+    };
+
+    uint16_t position_;
+    uint16_t step_;
+    uint16_t remaining_;
+    Easing easing_;
+
+}; // Transition
@@ -0,0 +1,26 @@
+# Example show: dusk, a candle in the window and a storm.
+#
+# Compile with: bin/cuec.py shows/example.cue include/shows/show.h
+
+white 0
+rgb #000000
+
+# dusk
+rgb #ff6000 5s
+wait 5s
+rgb #301060 8s
+wait 8s
+
+# someone lights a candle
+white 48 2s
+effect candle
+wait 10s
+
+# the storm comes, lightning on every press of the right button
+rgb #000020 3s
+storm:
+button right
+effect lightning
+wait 2s
+effect candle
+jump storm
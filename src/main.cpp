@@ -1,5 +1,47 @@
 #include "platform/platform.h"
 #include "peripherals/neopixel.h"
+#include "utils/settings.h"
+#include "utils/effects.h"
+#include "utils/transition.h"
+#include "utils/profiler.h"
+#include "utils/debug_display.h"
+#include "utils/thermal.h"
+#if (defined CUE_SHOW)
+#include "utils/cues.h"
+#include "shows/show.h"
+#endif
+#if (defined I2C_CONTROL) && (defined SERIAL_CONTROL)
+#error "I2C_CONTROL and SERIAL_CONTROL both use PA1 and PA2"
+#endif
+#if (defined I2C_CONTROL)
+#include "utils/i2c_registers.h"
+#define REMOTE_CONTROL
+#endif
+#if (defined SERIAL_CONTROL)
+#include "utils/serial_registers.h"
+#define REMOTE_CONTROL
+#endif
+#if (defined SYNC_LEADER) && (defined SYNC_FOLLOWER)
+#error "A light is either the SYNC_LEADER or a SYNC_FOLLOWER"
+#endif
+#if (defined SYNC_FOLLOWER) && (defined SERIAL_CONTROL)
+#error "SERIAL_CONTROL and the sync follower both use USART0"
+#endif
+#if (defined SYNC_LEADER) && (defined SERIAL_CONTROL)
+#error "The sync leader sends with the interrupts off for longer than the USART0 receive buffer holds SERIAL_CONTROL bytes"
+#endif
+#if ((defined SYNC_LEADER) || (defined SYNC_FOLLOWER)) && (defined PROFILE_TRACE)
+#error "PROFILE_TRACE and the sync wire both use PB3"
+#endif
+#if (defined SYNC_LEADER) || (defined SYNC_FOLLOWER)
+#include "utils/sync.h"
+#define SYNC
+#endif
+#if (defined REMOTE_CONTROL)
+#include <stddef.h>
+#else
+#define CHARGE_SENSE
+#endif
 
 
 /** Pinout
@@ -20,7 +62,21 @@ BTN_BRIGHTNESS_DOWN_PIN (3) PA7    UPDI (11)
   
     https://github.com/SpenceKonde/megaTinyCore/blob/master/megaavr/extras/ATtiny_x04.md
 
-    6x15R for 3R parallel for 200mA at 4.2V. The LED shoudl not work while charging, makes sense
+    When built with CUE_SHOW, the show in include/shows/show.h (compiled from a cue file by bin/cuec.py) is started and stopped by pressing both effect buttons. While it runs, the effect buttons are passed to the show.
+
+    When built with PROFILE and SERIAL_CONTROL, the duration of the tick, button checks and neopixel updates is sent to the host every 2.56 seconds, when built with PROFILE_TRACE defined to the id of a section, that section toggles PB3 instead, see utils/profiler.h. The debug display cannot show them, as the light does not bring up the TWI it needs and its default pins are the neopixel pins (PB0, PB1).
+
+    When built with I2C_CONTROL, the light is an I2C slave on the TWI alternate pins (PA1 SDA, PA2 SCL) so that a stage controller can drive it. The right effect button and the VCC pin are not available in this configuration.
+
+    When built with SERIAL_CONTROL, the same registers are exposed over the USART on its alternate pins (PA1 TX, PA2 RX) instead, see utils/serial_registers.h, with the same pins lost. The light can stream the registers as telemetry and with PROFILE, sends the profiler stats every 2.56 seconds. A sleeping light does not listen, it must be woken up by a button. 
+
+    When built with SYNC_LEADER or SYNC_FOLLOWER, the lights connected by their PB3 share the timebase of the leader, so that their rainbows, candles and effect updates run in step, see utils/sync.h. Neither can use SERIAL_CONTROL: a follower receives the beacons with the USART, and the leader sends them with the interrupts off for ~1ms, in which the USART would drop the bytes of a control frame. Sleeping followers drop out and lock again when woken up. 
+
+    While the USB charger is connected, which VCC_PIN reads (not available with I2C_CONTROL or SERIAL_CONTROL), the white LED is limited to CHARGE_WHITE_LIMIT, off by default, so that the charge current goes to the cell. A light that is off, or would only have the white LED on, then stays awake in the charge mode instead, which shows the charge as a dim pulse of the neopixel every 4 seconds, from red when empty to green when full. Connecting the charger wakes a sleeping light, disconnecting it powers a light in the charge mode off. 
+
+    The white LED and the neopixel are derated when the chip, which sits in the closed case with them, gets hot: their output is limited from THERMAL_DERATE_START (55C) down to a quarter at THERMAL_DERATE_END (75C), see utils/thermal.h. The brightness can thus be set for the sustained use, rather than capped for the worst case. 
+
+    6x15R for 3R parallel for 200mA at 4.2V. 
 */
 
 #define BTN_RGB_MODE_PIN 10
@@ -34,29 +90,128 @@ BTN_BRIGHTNESS_DOWN_PIN (3) PA7    UPDI (11)
 #define RGB_CONTROL_PIN 7
 #define VCC_PIN 8
 
-// 10 minutes for countdown
+// 10 minutes for countdown, the defaults can be overriden by build flags, e.g. to judge them by bin/energy.py
+#ifndef POWER_OFF_COUNTDOWN
 #define POWER_OFF_COUNTDOWN 10 * 60 * 100
+#endif
 
+#ifndef DEFAULT_BRIGHTNESS_WHITE
 #define DEFAULT_BRIGHTNESS_WHITE 32
+#endif
+#ifndef DEFAULT_BRIGHTNESS_RGB
 #define DEFAULT_BRIGHTNESS_RGB 64
+#endif
 
 #define CANDLE_STEP 4
 
+// number of 50ms steps of the lightning
+#define STROBE_STEPS 32
+
 #define BRIGHTNESS_STEP 16
 
+// brightness and color changes fade over 500ms
+#define FADE_TICKS 50
+
+// mode switches cross-fade the outputs over 500ms
+#define CROSSFADE_TICKS 50
+// blending and sending a single neopixel
+#define CROSSFADE_BUDGET 1000
+
+// the rainbow advances the hue every 50ms
+#define RAINBOW_TICKS 5
+
+// the sync leader sends its timebase every 250ms
+#ifndef SYNC_BEACON_TICKS
+#define SYNC_BEACON_TICKS 25
+#endif
+// synchronized candles flicker between random levels every 200ms
+#define SYNC_FLICKER_TICKS 20
+
+// the neopixel rail is cut after the neopixel was black for 1 second
+#define NEOPIXEL_HOLD_OFF_TICKS 100
+
+// current the neopixels may draw in mA, 0 for no limit, see NeopixelStrip::setCurrentLimit()
+#ifndef NEOPIXEL_CURRENT_LIMIT
+#define NEOPIXEL_CURRENT_LIMIT 0
+#endif
+
+// the charger is checked every 500ms, VCC_PIN reads above the threshold (of 1023 at VDD) while it is connected
+#define CHARGE_CHECK_TICKS 50
+#define CHARGE_THRESHOLD 512
+// white brightness allowed while charging, 0 turns the white LED off
+#ifndef CHARGE_WHITE_LIMIT
+#define CHARGE_WHITE_LIMIT 0
+#endif
+// the charge pulses every 4 seconds (in 50ms steps), up and down over 800ms, so that the neopixel rail is mostly off
+#define CHARGE_PULSE_STEPS 80
+#define CHARGE_PULSE_LENGTH 16
+#define CHARGE_PULSE_BRIGHTNESS 16
+// battery voltage in mV while charging shown as empty and as full
+#define CHARGE_EMPTY_VCC 3500
+#define CHARGE_FULL_VCC 4150
+
+// the temperature is sampled every second, filtered over ~8 seconds
+#define THERMAL_PERIOD_TICKS 100
+// the outputs are limited from the start temperature in C, down to THERMAL_MIN_OUTPUT at the end one
+#ifndef THERMAL_DERATE_START
+#define THERMAL_DERATE_START 55
+#endif
+#ifndef THERMAL_DERATE_END
+#define THERMAL_DERATE_END 75
+#endif
+#define THERMAL_MIN_OUTPUT 64
+
 // 50 ms debounce time
 #define DEBOUNCE_TICKS 5
 
+// settings are written to EEPROM after not changing for 3 seconds
+#define SETTINGS_COMMIT_TICKS 300
+// number of records in the EEPROM settings ring
+#define SETTINGS_SLOTS 16
+
+// effects and buttons of the cue shows, must match bin/cuec.py
+#define CUE_EFFECT_NONE 0
+#define CUE_EFFECT_CANDLE 1
+#define CUE_EFFECT_LIGHTNING 2
+#define CUE_BUTTON_LEFT 1
+#define CUE_BUTTON_RIGHT 2
+
+// default I2C address when controlled over I2C
+#ifndef I2C_CONTROL_ADDRESS
+#define I2C_CONTROL_ADDRESS 0x50
+#endif
+
+// default baudrate when controlled over serial, platformio.ini passes its monitor_speed
+#ifndef SERIAL_CONTROL_BAUDRATE
+#define SERIAL_CONTROL_BAUDRATE 115200
+#endif
+// frame with the stats of a profiled section, sent over serial
+#define SERIAL_FRAME_PROFILE 0x82
+
+/** Profiled sections.
+ */
+enum class Section : uint8_t {
+    Tick,
+    Buttons,
+    Neopixel,
+};
+
+PROFILE_SECTIONS(3)
+
+// worst case cycles of the profiled sections, sending a single neopixel takes 240
+#define BUTTONS_BUDGET 600
+#define NEOPIXEL_BUDGET 400
+
 enum class Mode : uint8_t {
     Off,
     White,
     Candle, 
     Strobe,  
     RGB,  
+    Charge,
+    Cue,
 };
 
-// current mode, starts in off mode 
-Mode mode = Mode::Off;
 // countdown till shutdown in 10ms ticks
 uint16_t countdown;
 uint8_t ticksDivider;
@@ -73,78 +228,473 @@ struct Button {
 // debounce counters
 Button buttons[6];
 
-NeopixelStrip<1> currentRgb(RGB_CONTROL_PIN);
+// powers its rail only while not black, see NeopixelStrip
+NeopixelStrip<1> currentRgb(RGB_CONTROL_PIN, RGB_PWR_PIN, NEOPIXEL_HOLD_OFF_TICKS);
 ColorStrip<1> rgb;
 uint8_t hue = 0;
 bool rainbow;
 
+// whether the charger is connected, and the charge from 0 (empty) to 255 (full) while it is
+bool charging = false;
+uint8_t chargeLevel;
+// ticks till the next check of the charger
+uint8_t chargeCheck = 1;
 
-/** Enters sleep mode */
-void sleep() {
-    digitalWrite(WHITE_PWM_PIN, 0);
-    digitalWrite(RGB_PWR_PIN, HIGH);
-    mode = Mode::Off;
-    cpu::sleep();
-    //countdown = 10 * 60 * 100; // 10 minutes
-    // this comes after wakeup
-    //rgb.fill(Color::Cyan().withBrightness(32));
-    //rgb.update();
-}
+ThermalLimiter<THERMAL_PERIOD_TICKS, THERMAL_DERATE_START, THERMAL_DERATE_END, THERMAL_MIN_OUTPUT> thermal;
+
+// transition of the white brightness from where it started to the target brightness
+Transition whiteFade;
+uint8_t whiteFrom;
+uint8_t whiteTarget;
+
+// transition of the RGB color from where it started to the (live) rgb target
+Transition rgbFade;
+ColorStrip<1> rgbFrom;
 
+// fade out of the output of the mode that was left, runs next to the effect of the new mode
+Transition crossfade;
+// white level the fade out started from, 0 when the RGB output is fading out
+uint8_t crossfadeWhite;
+bool crossfadeRgb;
+
+/** Settings remembered across power cycles. 
+ */
+struct Settings {
+    // last mode the light was in, either White or RGB
+    Mode mode;
+    uint8_t whiteBrightness;
+    uint8_t rgbBrightness;
+    uint8_t hue;
+    bool rainbow;
+} __attribute__((packed));
+
+Settings settings{Mode::RGB, DEFAULT_BRIGHTNESS_WHITE, DEFAULT_BRIGHTNESS_RGB, 0, true};
+SettingsStore<Settings, SETTINGS_SLOTS, SETTINGS_COMMIT_TICKS> settingsStore;
+
+#if (defined REMOTE_CONTROL)
+/** Register file exposed to the stage controller. 
+ 
+    The first four registers can be written by the controller, the rest is read only telemetry. 
+ */
+struct ControlRegisters {
+    Mode mode;
+    uint8_t brightness;
+    uint8_t hue;
+    uint8_t rainbow;
+    uint8_t currentBrightness;
+    uint16_t countdown;
+    // supply (battery) voltage in mV
+    uint16_t vcc;
+} __attribute__((packed));
+
+#if (defined I2C_CONTROL)
+using Control = I2CRegisters<ControlRegisters, 4>;
+
+I2C_REGISTERS_ISR(Control)
+#else
+using Control = SerialRegisters<ControlRegisters, 4>;
+
+SERIAL_REGISTERS_ISR(Control)
+#endif
+
+uint16_t vcc;
+#endif
+
+#if (defined SYNC)
+/** Timebase shared with the other lights, a whole turn of the rainbow long.
+ */
+#if (defined SYNC_LEADER)
+using Sync = SyncClock<true, 256 * RAINBOW_TICKS, SYNC_BEACON_TICKS>;
+#else
+using Sync = SyncClock<false, 256 * RAINBOW_TICKS, SYNC_BEACON_TICKS>;
+
+SYNC_CLOCK_ISR(Sync)
+#endif
+#endif
+
+
+/** Wakeup interrupt of the mode buttons. 
+ 
+    Does nothing, the work is done by resume() after the CPU wakes up. 
+ */
 void powerOn() {
     // nop
 }
 
 void powerOff() {
-    countdown = DEBOUNCE_TICKS + 1; // TODO maybe number of steps? 
+    // let the fade out finish before going to sleep
+    countdown = FADE_TICKS + 1;
     brightness = 0;
 }
 
 
-/** A 10ms tick that is used for animation and counting purposes.
- * 
+/** Starts a transition of the white output from the current brightness to the target brightness.
  */
-void tick() {
-    if (++ticksDivider % 5 != 0)
-       return;
-    // update brightness
-    if (currentBrightness < brightness)
-        ++currentBrightness;
-    else if (currentBrightness > brightness)
-        --currentBrightness;
-    // perform the mode or effect settings
-    switch (mode) {
-        case Mode::White:
-            analogWrite(WHITE_PWM_PIN, currentBrightness);
-            break;
-        case Mode::Candle: {
-            analogWrite(WHITE_PWM_PIN, currentBrightness);
-            uint8_t dir = random(0, brightness);
-            if (dir < currentBrightness)
-                currentBrightness = currentBrightness < CANDLE_STEP ? 0 : (currentBrightness - CANDLE_STEP);
-            else
-                currentBrightness = currentBrightness > (255 - CANDLE_STEP) ? 255 : (currentBrightness + CANDLE_STEP);
-            //currentBrightness = random(0, brightness);
-            break;
+void fadeBrightness() {
+    whiteFrom = currentBrightness;
+    whiteTarget = brightness;
+    whiteFade.start(FADE_TICKS, Easing::EaseInOut);
+}
+
+/** Advances the white transition, restarting it whenever the target brightness changes.
+ */
+void updateBrightness() {
+    if (brightness != whiteTarget)
+        fadeBrightness();
+    if (whiteFade.tick())
+        currentBrightness = whiteFade.apply(whiteFrom, whiteTarget);
+}
+
+/** Drives the white LED, limited by the temperature and to CHARGE_WHITE_LIMIT while charging.
+ */
+void writeWhite(uint8_t level) {
+    uint8_t limit = thermal.limit();
+    if (charging && limit > CHARGE_WHITE_LIMIT)
+        limit = CHARGE_WHITE_LIMIT;
+    analogWrite(WHITE_PWM_PIN, level > limit ? limit : level);
+}
+
+/** Samples the temperature when due. A change of the thermal limit is applied to the neopixel as its brightness right away, to the white LED by the next writeWhite().
+ */
+void updateThermal() {
+    if (thermal.tick()) {
+        currentRgb.setBrightness(thermal.limit());
+        currentRgb.markAsChanged();
+    }
+}
+
+/** Sends the RGB color to the neopixel, if changed.
+ */
+void updateRgb() {
+    PROFILE_SCOPE(Section::Neopixel, NEOPIXEL_BUDGET);
+    currentRgb.update();
+}
+
+/** Starts fading the white output out, used when switching to RGB.
+ */
+void crossfadeWhiteOut() {
+    crossfadeWhite = currentBrightness;
+    crossfadeRgb = false;
+    crossfade.start(CROSSFADE_TICKS, Easing::EaseInOut);
+}
+
+/** Starts fading the RGB output out, used when switching to white. The strip cuts the neopixel rail once it has been black for the hold-off.
+ */
+void crossfadeRgbOut() {
+    crossfadeWhite = 0;
+    crossfadeRgb = true;
+    rgbFrom = currentRgb;
+    rgb.fill(Color::Black());
+    crossfade.start(CROSSFADE_TICKS, Easing::EaseInOut);
+}
+
+/** Stops the cross-fade where it is, for effects that drive both outputs themselves.
+ */
+void stopCrossfade() {
+    crossfade.stop();
+    crossfadeWhite = 0;
+    crossfadeRgb = false;
+}
+
+/** Advances the cross-fade, if any.
+ 
+    Runs every tick next to the effect of the new mode, which drives the other output, so that both outputs stay lit during the overlap. Costs at most CROSSFADE_BUDGET. 
+ */
+void updateCrossfade() {
+    if (! crossfade.tick())
+        return;
+    if (crossfadeRgb) {
+        currentRgb.blend(rgbFrom, rgb, crossfade.progress());
+        if (crossfade.done())
+            crossfadeRgb = false;
+    } else {
+        writeWhite(crossfade.apply(crossfadeWhite, 0));
+        if (crossfade.done())
+            crossfadeWhite = 0;
+    }
+}
+
+#if (defined SYNC)
+/** Returns the flame of a candle flickering below the given brightness. 
+ 
+    Instead of a random walk, which would never meet again on lights that entered the candle at different times, the flame moves smoothly between random levels of the shared timebase every SYNC_FLICKER_TICKS, so that the candles of all lights flicker together. 
+ */
+uint8_t flicker(uint8_t, uint8_t max) {
+    constexpr uint16_t LEVELS = 256 * RAINBOW_TICKS / SYNC_FLICKER_TICKS;
+    static_assert(LEVELS * SYNC_FLICKER_TICKS == 256 * RAINBOW_TICKS, "Flicker must divide the timebase");
+    uint16_t level = Sync::ticks() / SYNC_FLICKER_TICKS;
+    uint8_t phase = Sync::ticks() % SYNC_FLICKER_TICKS;
+    uint8_t from = Sync::noise(level);
+    uint8_t to = Sync::noise(level + 1 == LEVELS ? 0 : level + 1);
+    uint8_t flame = Lerp(from, to, (static_cast<uint16_t>(phase) << 8) / SYNC_FLICKER_TICKS);
+    return (flame * (max + 1)) >> 8;
+}
+#else
+/** Returns the next flame of a candle flickering below the given brightness. 
+ */
+uint8_t flicker(uint8_t flame, uint8_t max) {
+    uint8_t dir = random(0, max);
+    if (dir < flame)
+        return flame < CANDLE_STEP ? 0 : (flame - CANDLE_STEP);
+    else
+        return flame > (255 - CANDLE_STEP) ? 255 : (flame + CANDLE_STEP);
+}
+#endif
+
+/** Returns the lightning brightness at given step. 
+ */
+uint8_t flash(uint8_t step, uint8_t level) {
+    return (step >> 2) & 1 ? level : 0;
+}
+
+/** The light is off, nothing to animate.
+ */
+struct OffEffect {
+    struct State {};
+    static constexpr uint8_t PERIOD = 255;
+    static constexpr uint16_t BUDGET = 16;
+
+    static void enter(State &) {}
+    static void update(State &) {}
+}; // OffEffect
+
+/** Steady white light, fading smoothly to the set brightness.
+ */
+struct WhiteEffect {
+    struct State {};
+    static constexpr uint8_t PERIOD = 1;
+    static constexpr uint16_t BUDGET = 200;
+
+    static void enter(State &) {
+        fadeBrightness();
+    }
+
+    static void update(State &) {
+        writeWhite(currentBrightness);
+    }
+}; // WhiteEffect
+
+/** Candlelight, the flame randomly flickers below the set brightness.
+ */
+struct CandleEffect {
+    struct State {
+        uint8_t flame;
+    };
+    static constexpr uint8_t PERIOD = 5;
+    // dominated by random()
+    static constexpr uint16_t BUDGET = 2500;
+
+    static void enter(State & state) {
+        state.flame = currentBrightness;
+    }
+
+    static void update(State & state) {
+        writeWhite(state.flame);
+        state.flame = flicker(state.flame, brightness);
+        // so that leaving the candle does not jump
+        currentBrightness = state.flame;
+    }
+}; // CandleEffect
+
+/** A short burst of flashes (lightning), returns to white when done.
+ */
+struct StrobeEffect {
+    struct State {
+        uint8_t step;
+    };
+    static constexpr uint8_t PERIOD = 5;
+    static constexpr uint16_t BUDGET = 250;
+
+    static void enter(State & state) {
+        state.step = 0;
+    }
+
+    static void update(State & state);
+}; // StrobeEffect
+
+/** RGB color, either fixed or cycling through the rainbow.
+ 
+    Changes of the color, other than the rainbow moving on, start a transition to the new color. The rainbow keeps going during the transition since it blends towards the live target. 
+ */
+struct RGBEffect {
+    struct State {
+        uint8_t divider;
+        // the target the last transition was started for
+        uint8_t hue;
+        uint8_t brightness;
+        bool rainbow;
+    };
+    static constexpr uint8_t PERIOD = 1;
+    // HSV conversion and the blend of the transition, every tick, checked against the cycles measured by bin/bench.py (EffectRGB)
+    static constexpr uint16_t BUDGET = 1500;
+
+    static void enter(State & state) {
+        state.divider = 0;
+        fade(state);
+    }
+
+    static void update(State & state) {
+#if (defined SYNC)
+        // the hue of the shared timebase, jumps to it (e.g. entering the rainbow, or a correction of the timebase) fade
+        if (rainbow && Sync::ticks() % RAINBOW_TICKS == 0) {
+            uint8_t next = Sync::ticks() / RAINBOW_TICKS;
+            if (next == static_cast<uint8_t>(hue + 1))
+                state.hue = next;
+            hue = next;
         }
-        case Mode::Strobe:
-            if (++hue == 32)
-                mode = Mode::White;
-            else
-                analogWrite(WHITE_PWM_PIN, (hue >> 2) & 1 ? currentBrightness : 0);
-            break;
-        case Mode::RGB:
-            rgb.fill(Color::HSV(hue, 255, brightness));
-            if (currentRgb.moveTowards(rgb)) {
-                currentRgb.update();
-                if (rainbow)
-                    hue += 1;
-            }
-            break;
-        default:
-            // unreachable
-            break;
+#else
+        if (rainbow && ++state.divider == RAINBOW_TICKS) {
+            state.divider = 0;
+            state.hue = ++hue;
+        }
+#endif
+        if (hue != state.hue || brightness != state.brightness || rainbow != state.rainbow)
+            fade(state);
+        rgb.fill(Color::HSV(hue, 255, brightness));
+        if (rgbFade.tick())
+            currentRgb.blend(rgbFrom, rgb, rgbFade.progress());
+        else
+            currentRgb.moveTowards(rgb, 255);
+    }
+
+    static void fade(State & state) {
+        state.hue = hue;
+        state.brightness = brightness;
+        state.rainbow = rainbow;
+        rgbFrom = currentRgb;
+        rgbFade.start(FADE_TICKS, Easing::EaseInOut);
     }
+}; // RGBEffect
+
+/** The light is off while charging, the neopixel shows the charge as a dim pulse every CHARGE_PULSE_STEPS, its hue going from red (empty) to green (full).
+ */
+struct ChargeEffect {
+    struct State {
+        uint8_t step;
+    };
+    static constexpr uint8_t PERIOD = 5;
+    // HSV conversion
+    static constexpr uint16_t BUDGET = 1200;
+
+    static void enter(State & state) {
+        state.step = 0;
+    }
+
+    static void update(State & state) {
+        constexpr uint8_t HALF = CHARGE_PULSE_LENGTH / 2;
+        uint8_t step = state.step;
+        if (++state.step == CHARGE_PULSE_STEPS)
+            state.step = 0;
+        uint8_t level = step < HALF ? step : step < CHARGE_PULSE_LENGTH ? CHARGE_PULSE_LENGTH - step : 0;
+        currentRgb.fill(Color::HSV((chargeLevel * 85) >> 8, 255, level * CHARGE_PULSE_BRIGHTNESS / HALF));
+    }
+}; // ChargeEffect
+
+#if (defined CUE_SHOW)
+CuePlayer show;
+// effect buttons pressed since the last tick, for the show
+uint8_t showButtons;
+
+/** Runs the cue show. 
+ 
+    Updates every tick so that fades and waits are exact to the tick. The candle and lightning effects of the show still animate at the 50ms cadence of their standalone versions, below the white level the show sets. 
+ */
+struct CueEffect {
+    struct State {
+        uint8_t divider;
+        uint8_t flame;
+        uint8_t step;
+        Color color;
+    };
+    static constexpr uint8_t PERIOD = 1;
+    // candle's random() and sending a single neopixel
+    static constexpr uint16_t BUDGET = 3500;
+
+    static void enter(State & state) {
+        whiteFade.stop();
+        stopCrossfade();
+        state.divider = 0;
+        state.flame = currentBrightness;
+        state.step = 0;
+        state.color = Color::Black();
+        currentRgb.fill(state.color);
+        showButtons = 0;
+        show.start(SHOW_CUES, currentBrightness, state.color);
+    }
+
+    static void update(State & state) {
+        show.tick(showButtons);
+        showButtons = 0;
+        uint8_t white = show.white();
+        bool animate = (++state.divider == 5);
+        if (animate)
+            state.divider = 0;
+        switch (show.effect()) {
+            case CUE_EFFECT_CANDLE:
+                if (animate)
+                    state.flame = flicker(state.flame, white);
+                white = state.flame;
+                break;
+            case CUE_EFFECT_LIGHTNING:
+                if (animate && ++state.step == STROBE_STEPS) {
+                    state.step = 0;
+                    show.clearEffect();
+                }
+                white = flash(state.step, white);
+                break;
+            default:
+                state.flame = white;
+                state.step = 0;
+                break;
+        }
+        currentBrightness = white;
+        writeWhite(white);
+        Color color = show.color();
+        if (color != state.color) {
+            state.color = color;
+            currentRgb.fill(color);
+        }
+    }
+}; // CueEffect
+
+/** The effects, in the order of the Mode enum so that effect ids and modes are interchangeable.
+ */
+Effects<OffEffect, WhiteEffect, CandleEffect, StrobeEffect, RGBEffect, ChargeEffect, CueEffect> effects;
+#else
+Effects<OffEffect, WhiteEffect, CandleEffect, StrobeEffect, RGBEffect, ChargeEffect> effects;
+#endif
+
+static_assert(effects.id<CandleEffect>() == static_cast<uint8_t>(Mode::Candle), "Effects must be in the Mode order");
+static_assert(effects.id<RGBEffect>() == static_cast<uint8_t>(Mode::RGB), "Effects must be in the Mode order");
+static_assert(effects.id<ChargeEffect>() == static_cast<uint8_t>(Mode::Charge), "Effects must be in the Mode order");
+// on the declared budgets, bin/bench.py fails if the simulated firmware takes more cycles than they declare
+static_assert(decltype(effects)::MAX_BUDGET + CROSSFADE_BUDGET + NEOPIXEL_BUDGET < F_CPU / 100, "Effects do not fit in the 10ms tick");
+
+void StrobeEffect::update(State & state) {
+    if (++state.step == STROBE_STEPS)
+        effects.enter<WhiteEffect>();
+    else
+        writeWhite(flash(state.step, currentBrightness));
+}
+
+Mode mode() {
+    return static_cast<Mode>(effects.current());
+}
+
+/** A 10ms tick that is used for animation and counting purposes.
+ */
+void tick() {
+    PROFILE_SCOPE(Section::Tick, decltype(effects)::MAX_BUDGET + CROSSFADE_BUDGET + NEOPIXEL_BUDGET);
+#if (defined SYNC)
+    if (Sync::tick())
+        effects.align(Sync::ticks());
+#endif
+    ++ticksDivider;
+    updateBrightness();
+    updateCrossfade();
+    effects.tick();
+    // every tick, as the strip counts the hold-off of its rail in updates
+    updateRgb();
 }
 
 bool checkButton(uint8_t index, uint8_t pin) {
@@ -166,37 +716,225 @@ bool checkButton(uint8_t index, uint8_t pin) {
     }
 }
 
+/** Enters the charge mode, cutting the outputs of the mode it was in.
+ */
+void enterChargeMode() {
+    countdown = POWER_OFF_COUNTDOWN;
+    stopCrossfade();
+    brightness = 0;
+    writeWhite(0);
+    effects.enter<ChargeEffect>();
+}
+
+/** Enters the white mode, cross-fading from the RGB output.
+ 
+    Coming from RGB, the white output fades in from where its fade out got to. Coming from off, it fades in from the lowest level that lights, so that the light comes on with the very next tick. While charging with the white LED off, enters the charge mode instead. 
+ */
+void enterWhiteMode() {
+    if (charging && CHARGE_WHITE_LIMIT == 0) {
+        enterChargeMode();
+        return;
+    }
+    if (mode() == Mode::RGB)
+        currentBrightness = crossfade.apply(crossfadeWhite, 0);
+    else if (mode() == Mode::Off && currentBrightness == 0)
+        currentBrightness = 1;
+    crossfadeRgbOut();
+    brightness = settings.whiteBrightness;
+    effects.enter<WhiteEffect>();
+}
+
+/** Enters the RGB mode, cross-fading from the white output. 
+ 
+    The RGB effect fades in from whatever the neopixel shows. Coming from off, when that is black, it fades in from the color at the lowest level that lights instead, so that the neopixel comes on as soon as its rail has settled. 
+ */
 void enterRGBMode() {
-    digitalWrite(RGB_PWR_PIN, LOW); // on 
-    mode = Mode::RGB;
-    hue = 0;
-    rainbow = true;
-    brightness = DEFAULT_BRIGHTNESS_RGB;
-    rgb.fill(Color::HSV(hue * 255, 255, brightness));
+    crossfadeWhiteOut();
+    hue = settings.hue;
+    rainbow = settings.rainbow;
+    brightness = settings.rgbBrightness;
+    if (mode() == Mode::Off && currentRgb.channelSum() == 0)
+        currentRgb.fill(Color::HSV(hue, 255, 1));
+    effects.enter<RGBEffect>();
+}
+
+/** Updates the remembered settings from the current state. 
+ 
+    Zero brightness means we are powering off, which should not be remembered. The hue is not remembered while cycling through the rainbow as it changes all the time. 
+ */
+void rememberSettings() {
+    if (brightness == 0)
+        return;
+    switch (mode()) {
+        case Mode::White:
+        case Mode::Candle:
+            settings.mode = Mode::White;
+            settings.whiteBrightness = brightness;
+            break;
+        case Mode::RGB:
+            settings.mode = Mode::RGB;
+            settings.rgbBrightness = brightness;
+            settings.rainbow = rainbow;
+            if (! rainbow)
+                settings.hue = hue;
+            break;
+        default:
+            break;
+    }
+    settingsStore.update(settings);
+    settingsStore.tick();
+}
+
+#if (defined CHARGE_SENSE)
+/** Reads whether the charger is connected, and the charge while it is. Returns true if charging. 
+ */
+bool checkCharger() {
+    chargeCheck = CHARGE_CHECK_TICKS;
+    charging = adc::read(VCC_PIN) >= CHARGE_THRESHOLD;
+    if (charging) {
+        uint16_t mv = adc::readVcc();
+        if (mv <= CHARGE_EMPTY_VCC)
+            chargeLevel = 0;
+        else if (mv >= CHARGE_FULL_VCC)
+            chargeLevel = 255;
+        else
+            chargeLevel = static_cast<uint32_t>(mv - CHARGE_EMPTY_VCC) * 255 / (CHARGE_FULL_VCC - CHARGE_EMPTY_VCC);
+    }
+    return charging;
+}
+
+/** Checks the charger every CHARGE_CHECK_TICKS. 
+ 
+    Connecting it limits the white LED (see writeWhite()) and, if that turns the LED off, moves a light not in the RGB mode to the charge mode. Disconnecting it powers a light in the charge mode off. 
+ */
+void updateCharger() {
+    if (--chargeCheck != 0)
+        return;
+    bool was = charging;
+    if (checkCharger() == was)
+        return;
+    if (charging) {
+        if (CHARGE_WHITE_LIMIT == 0 && mode() != Mode::RGB)
+            enterChargeMode();
+    } else if (mode() == Mode::Charge) {
+        powerOff();
+    }
+}
+#endif
+
+/** Warm resume after a mode button woke the light up from sleep. 
+
+    Only the outputs that sleep() shut down are brought back, by entering the mode the button selects with the remembered settings. The brightness ramps up from zero (which the LEDs were at while sleeping) and entering the mode schedules the first animation step for the very next tick so that the light comes on within milliseconds of the press. 
+ */
+void resume(uint8_t button) {
+    countdown = POWER_OFF_COUNTDOWN;
+    // the press that woke us up must not be seen again by checkButtons()
+    buttons[button].state = false;
+    buttons[button].debounce = DEBOUNCE_TICKS;
+    currentBrightness = 0;
+    // the neopixel lost power so whatever it showed is gone
+    currentRgb.fill(Color::Black());
+    currentRgb.markAsChanged();
+    if (button == 0)
+        enterWhiteMode();
+    else
+        enterRGBMode();
+}
+
+/** Enters sleep mode. 
+ 
+    Shuts the outputs down and powers the CPU down until one of the mode buttons is pressed. Other wakeups, such as the release of the button that powered the light off, go straight back to sleep. In the I2C controlled build the light instead stays awake (but off) when woken up by the controller so that it can be turned on remotely. 
+ */
+void sleep() {
+    settingsStore.flush();
+#if (defined CHARGE_SENSE)
+    if (checkCharger()) {
+        enterChargeMode();
+        return;
+    }
+#endif
+    stopCrossfade();
+    digitalWrite(WHITE_PWM_PIN, LOW);
+    currentRgb.powerDown();
+    effects.enter<OffEffect>();
+    while (true) {
+        cpu::sleep();
+        if (digitalRead(BTN_WHITE_MODE_PIN) == LOW) {
+            resume(0);
+            return;
+        }
+        if (digitalRead(BTN_RGB_MODE_PIN) == LOW) {
+            resume(1);
+            return;
+        }
+#if (defined CHARGE_SENSE)
+        if (checkCharger()) {
+            // the neopixel lost power so whatever it showed is gone
+            currentRgb.fill(Color::Black());
+            currentRgb.markAsChanged();
+            enterChargeMode();
+            return;
+        }
+#endif
+#if (defined I2C_CONTROL)
+        if (Control::pending()) {
+            countdown = POWER_OFF_COUNTDOWN;
+            return;
+        }
+#endif
+    }
+}
+
+/** Handles effect button presses for the cue show. 
+ 
+    Pressing an effect button while the other one is held starts or stops the show, otherwise while the show runs, the press is passed to it. Returns true if the press was consumed. 
+ */
+bool showButton(uint8_t mask, uint8_t other) {
+#if (defined CUE_SHOW) && (! defined REMOTE_CONTROL)
+    bool both = ! buttons[other].state;
+    if (mode() == Mode::Cue) {
+        if (both)
+            enterWhiteMode();
+        else
+            showButtons |= mask;
+        return true;
+    } else if (both) {
+        effects.enter<CueEffect>();
+        return true;
+    }
+#elif (defined CUE_SHOW)
+    (void)other;
+    if (mode() == Mode::Cue) {
+        showButtons |= mask;
+        return true;
+    }
+#else
+    (void)mask;
+    (void)other;
+#endif
+    return false;
 }
 
 /** Checks whether a button was pressed and performs a very simple debouncing.  
  */
 void checkButtons() {
+    PROFILE_SCOPE(Section::Buttons, BUTTONS_BUDGET);
     if (checkButton(0, BTN_WHITE_MODE_PIN)) {
-        if (mode == Mode::Off || mode == Mode::RGB) {
-            mode = Mode::White;
-            currentBrightness = 0;
-            brightness = DEFAULT_BRIGHTNESS_WHITE;
-            digitalWrite(RGB_PWR_PIN, HIGH);
+        if (mode() == Mode::Off || mode() == Mode::RGB || mode() == Mode::Charge) {
+            enterWhiteMode();
         } else {
             powerOff(); 
         }
     }
     if (checkButton(1, BTN_RGB_MODE_PIN)) {
-        if (mode != Mode::RGB) {
+        if (mode() != Mode::RGB) {
             enterRGBMode();
         } else {
             powerOff();
         }
     }
-    if (checkButton(2, BTN_EFFECT_L_PIN)) {
-        if (mode == Mode::RGB) {
+    if (checkButton(2, BTN_EFFECT_L_PIN) && ! showButton(CUE_BUTTON_LEFT, 3)) {
+        if (mode() == Mode::RGB) {
             if (hue == 0) {
                 rainbow = true;
             } else {
@@ -205,15 +943,16 @@ void checkButtons() {
                 else
                     hue = 0;
             }
-        } else {
-            if (mode != Mode::Candle)
-                mode = Mode::Candle;
+        } else if (mode() != Mode::Charge) {
+            if (mode() != Mode::Candle)
+                effects.enter<CandleEffect>();
             else 
-                mode = Mode::White;
+                effects.enter<WhiteEffect>();
         }
     }
-    if (checkButton(3, BTN_EFFECT_R_PIN)) {
-        if (mode == Mode::RGB) {
+#if (! defined REMOTE_CONTROL)
+    if (checkButton(3, BTN_EFFECT_R_PIN) && ! showButton(CUE_BUTTON_RIGHT, 2)) {
+        if (mode() == Mode::RGB) {
             if (rainbow) {
                 rainbow = false;
                 hue = 0;
@@ -222,11 +961,11 @@ void checkButtons() {
             } else {
                 hue = 248;
             }
-        } else {
-            mode = Mode::Strobe;
-            hue = 0;
+        } else if (mode() != Mode::Charge) {
+            effects.enter<StrobeEffect>();
         }
     }
+#endif
     if (checkButton(4, BTN_BRIGHTNESS_DOWN_PIN)) {
         brightness = brightness > BRIGHTNESS_STEP ? brightness - BRIGHTNESS_STEP : 8;
         /*
@@ -248,24 +987,109 @@ void checkButtons() {
     }
 }
 
+#if (defined REMOTE_CONTROL)
+/** Applies the registers written by the stage controller and publishes the current state. 
+ 
+    Only the registers the controller wrote are applied, the others hold the state last published, which the buttons or the effects may have changed since. 
+ */
+void checkControl() {
+    ControlRegisters regs;
+    uint8_t written = Control::fetch(regs);
+    if (written & Control::mask(offsetof(ControlRegisters, mode)) && regs.mode != mode()) {
+        switch (regs.mode) {
+            case Mode::Off:
+                powerOff();
+                break;
+            case Mode::White:
+                enterWhiteMode();
+                break;
+            case Mode::Candle:
+            case Mode::Strobe:
+            case Mode::Cue:
+                if (mode() == Mode::Off || mode() == Mode::RGB)
+                    enterWhiteMode();
+                effects.enter(static_cast<uint8_t>(regs.mode));
+                break;
+            case Mode::RGB:
+                enterRGBMode();
+                break;
+            default:
+                // invalid mode, ignore
+                break;
+        }
+    }
+    if (written != 0 && regs.mode != Mode::Off) {
+        if (written & Control::mask(offsetof(ControlRegisters, brightness)))
+            brightness = regs.brightness;
+        if (written & Control::mask(offsetof(ControlRegisters, hue)))
+            hue = regs.hue;
+        if (written & Control::mask(offsetof(ControlRegisters, rainbow)))
+            rainbow = regs.rainbow;
+        countdown = POWER_OFF_COUNTDOWN;
+    }
+    // measuring the supply is relatively slow, do it only every 2.56 seconds
+    if (ticksDivider == 0)
+        vcc = adc::readVcc();
+    regs.mode = mode();
+    regs.brightness = brightness;
+    regs.hue = hue;
+    regs.rainbow = rainbow;
+    regs.currentBrightness = currentBrightness;
+    regs.countdown = countdown;
+    regs.vcc = vcc;
+    Control::publish(regs);
+}
+#endif
+
+#if (defined PROFILE) && (defined SERIAL_CONTROL)
+/** Sends the stats of a profiled section to the host. Returns false if the transmit buffer is full, in which case the stats are kept and sent with the next report.
+ */
+bool sendProfile(uint8_t section, SectionProfiler::Stats const & stats) {
+    struct {
+        uint8_t section;
+        SectionProfiler::Stats stats;
+    } __attribute__((packed)) frame{section, stats};
+    return Control::send(SERIAL_FRAME_PROFILE, & frame, sizeof(frame));
+}
+#endif
+
 void setup() {
     pinMode(BTN_BRIGHTNESS_DOWN_PIN, INPUT_PULLUP);
     pinMode(BTN_BRIGHTNESS_UP_PIN, INPUT_PULLUP);
     pinMode(BTN_EFFECT_L_PIN, INPUT_PULLUP);
+#if (! defined REMOTE_CONTROL)
     pinMode(BTN_EFFECT_R_PIN, INPUT_PULLUP);
+#endif
     pinMode(BTN_WHITE_MODE_PIN, INPUT_PULLUP);
     pinMode(BTN_RGB_MODE_PIN, INPUT_PULLUP);
     pinMode(WHITE_PWM_PIN, OUTPUT);
-    pinMode(RGB_PWR_PIN, OUTPUT);
     pinMode(RGB_CONTROL_PIN, OUTPUT);
+#if (defined I2C_CONTROL)
+    Control::initialize(I2C_CONTROL_ADDRESS, true);
+#elif (defined SERIAL_CONTROL)
+    Control::initialize(SERIAL_CONTROL_BAUDRATE, true);
+#else
     pinMode(VCC_PIN, INPUT);
+    // connecting the charger wakes the light up
+    attachInterrupt(digitalPinToInterrupt(VCC_PIN), powerOn, CHANGE);
+#endif
+#if (defined SYNC)
+    Sync::initialize();
+#endif
     digitalWrite(WHITE_PWM_PIN, LOW);
-    digitalWrite(RGB_PWR_PIN, HIGH); // off
-    attachInterrupt(digitalPinToInterrupt(BTN_WHITE_MODE_PIN), powerOn, FALLING);
-    attachInterrupt(digitalPinToInterrupt(BTN_RGB_MODE_PIN), powerOn, FALLING);
-    // enter RGB Mode
+    currentRgb.setCurrentLimit(NEOPIXEL_CURRENT_LIMIT);
+    DDISP_INITIALIZE();
+    PROFILE_INITIALIZE();
+    // the mode button pins are not fully asynchronous, so only detecting both edges wakes the CPU from power down
+    attachInterrupt(digitalPinToInterrupt(BTN_WHITE_MODE_PIN), powerOn, CHANGE);
+    attachInterrupt(digitalPinToInterrupt(BTN_RGB_MODE_PIN), powerOn, CHANGE);
+    // restore the last used mode
     countdown = POWER_OFF_COUNTDOWN;
-    enterRGBMode();
+    settingsStore.restore(settings);
+    if (settings.mode == Mode::White)
+        enterWhiteMode();
+    else
+        enterRGBMode();
 }
 
 void loop() {
@@ -273,6 +1097,37 @@ void loop() {
     if (--countdown == 0)
         sleep();
     checkButtons();
+#if (defined REMOTE_CONTROL)
+    checkControl();
+#endif
+#if (defined CHARGE_SENSE)
+    updateCharger();
+#endif
+    updateThermal();
     tick();
+#if (defined PROFILE) && (defined SERIAL_CONTROL)
+    if (ticksDivider == 0)
+        PROFILE_REPORT(sendProfile);
+#endif
+    rememberSettings();
+#if (defined SYNC)
+    Sync::wait(10);
+#else
     cpu::delay_ms(10);
-}
\ No newline at end of file
+#endif
+}
+#if (defined ARCH_AVR_BAREMETAL)
+GPIO_INTERRUPTS_ISR()
+
+#if (! defined BENCH)
+/** Without the Arduino core, the firmware has its own main. The benchmarks (bench/bench.cpp) include the firmware with their own. 
+ */
+int main() {
+    cpu::initialize();
+    sei();
+    setup();
+    while (true)
+        loop();
+}
+#endif
+#endif